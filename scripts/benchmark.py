@@ -0,0 +1,418 @@
+"""
+Reproducible benchmarks for the sequali modules and the command line.
+
+Synthetic corpora are generated from a fixed seed, so results can be compared
+between versions and machines. Each measurement runs in its own process,
+which allows the CPU dispatch to be limited with SEQUALI_SIMD and gives the
+peak memory of that measurement only.
+
+Generate the corpora once, then benchmark and store a baseline:
+
+    python scripts/benchmark.py generate bench_data
+    python scripts/benchmark.py run bench_data --output baseline.json
+
+After a change, compare against the baseline. The exit code is 1 when a
+benchmark got slower than the tolerance allows:
+
+    python scripts/benchmark.py run bench_data --baseline baseline.json
+
+Real-world files can be added with --corpus NAME=PATH[,PATH2], the second
+path being read 2 for paired data.
+"""
+import argparse
+import contextlib
+import gzip
+import json
+import os
+import random
+import resource
+import struct
+import subprocess
+import sys
+import time
+import uuid
+import zlib
+from pathlib import Path
+from typing import Any, Dict, Iterator, List, Tuple
+
+# Values for SEQUALI_SIMD. "avx2" leaves the dispatch unlimited.
+SIMD_VARIANTS = ("avx2", "ssse3", "default")
+
+NUCLEOTIDES = "ACGT"
+ILLUMINA_ADAPTER = "AGATCGGAAGAGCACACGTCTGAACTCCAGTCA"
+NANOPORE_ADAPTER = "TTTTTTTTCCTGTACTTCGTTCAGTTACGTATTGCT"
+BAM_NUCLEOTIDES = "=ACMGRSVTWYHKDBN"
+BGZF_BLOCK_SIZE = 0xff00
+BGZF_EOF = bytes.fromhex("1f8b08040000000000ff0600424302001b0003000000000000000000")
+
+# Number of reads per profile, chosen so a run takes a few seconds.
+PROFILES = {
+    "short-read": 500_000,
+    "long-read": 20_000,
+    "paired": 250_000,
+    "ubam": 20_000,
+}
+
+
+def random_sequence(rng: random.Random, length: int) -> str:
+    return "".join(rng.choices(NUCLEOTIDES, k=length))
+
+
+def illumina_reads(rng: random.Random, number_of_reads: int, read: int,
+                   length: int = 150) -> Iterator[Tuple[str, str, str]]:
+    # A fixed pool of fragments gives duplicates and overrepresented
+    # sequences, a fraction of short inserts gives adapter read-through.
+    pool = [random_sequence(rng, length) for _ in range(1000)]
+    for i in range(number_of_reads):
+        tile = 1101 + i % 12
+        name = (f"SIM:1:FCX:1:{tile}:{i % 30000}:{i // 30000} "
+                f"{read}:N:0:ACGTACGT")
+        if i % 50 == 0:
+            sequence = pool[i % len(pool)]
+        elif i % 20 == 0:
+            insert = random_sequence(rng, rng.randrange(20, length))
+            sequence = (insert + ILLUMINA_ADAPTER + random_sequence(
+                rng, length))[:length]
+        else:
+            sequence = random_sequence(rng, length)
+        # Qualities drop towards the end of the read.
+        qualities = "".join(
+            chr(33 + max(2, 38 - position // 10 - rng.randrange(8)))
+            for position in range(length))
+        yield name, sequence, qualities
+
+
+def nanopore_reads(rng: random.Random, number_of_reads: int
+                   ) -> Iterator[Tuple[str, str, str]]:
+    for i in range(number_of_reads):
+        length = min(int(rng.lognormvariate(8.5, 0.8)) + 100, 100_000)
+        read_id = uuid.UUID(int=rng.getrandbits(128))
+        name = (f"{read_id} runid=0 ch={i % 512 + 1} "
+                f"start_time=2024-01-01T{i // 3600 % 24:02}:"
+                f"{i // 60 % 60:02}:{i % 60:02}Z")
+        sequence = NANOPORE_ADAPTER + random_sequence(rng, length)
+        qualities = "".join(chr(33 + rng.randrange(5, 40))
+                            for _ in range(len(sequence)))
+        yield name, sequence, qualities
+
+
+def write_fastq(path: Path, reads: Iterator[Tuple[str, str, str]]):
+    # Level 1 keeps generating fast, decompression speed is hardly affected.
+    with gzip.open(path, "wt", compresslevel=1) as fastq:
+        for name, sequence, qualities in reads:
+            fastq.write(f"@{name}\n{sequence}\n+\n{qualities}\n")
+
+
+def bam_record(name: str, sequence: str, qualities: str) -> bytes:
+    codes = [BAM_NUCLEOTIDES.index(nuc) for nuc in sequence]
+    if len(codes) % 2:
+        codes.append(0)
+    encoded = bytes(upper << 4 | lower
+                    for upper, lower in zip(codes[::2], codes[1::2]))
+    read_name = name.encode("ascii") + b"\x00"
+    # refID, pos, l_read_name, mapq, bin, n_cigar_op, flag (unmapped), l_seq,
+    # next_refID, next_pos, tlen
+    fields = struct.pack("<iiBBHHHiiii", -1, -1, len(read_name), 255, 4680,
+                         0, 4, len(sequence), -1, -1, 0)
+    data = (fields + read_name + encoded +
+            bytes(ord(q) - 33 for q in qualities))
+    return struct.pack("<I", len(data)) + data
+
+
+def bgzf_block(data: bytes) -> bytes:
+    compressor = zlib.compressobj(1, zlib.DEFLATED, -15)
+    compressed = compressor.compress(data) + compressor.flush()
+    header = struct.pack("<BBBBIBBHBBHH", 0x1f, 0x8b, 8, 4, 0, 0, 0xff, 6,
+                         ord("B"), ord("C"), 2, len(compressed) + 25)
+    return (header + compressed +
+            struct.pack("<II", zlib.crc32(data), len(data)))
+
+
+def write_ubam(path: Path, reads: Iterator[Tuple[str, str, str]]):
+    text = b"@HD\tVN:1.6\tSO:unknown\n@RG\tID:bench\tPL:ONT\n"
+    buffer = bytearray(b"BAM\x01" + struct.pack("<I", len(text)) + text +
+                       struct.pack("<I", 0))
+    with open(path, "wb") as bam:
+        for read in reads:
+            buffer += bam_record(*read)
+            while len(buffer) >= BGZF_BLOCK_SIZE:
+                bam.write(bgzf_block(bytes(buffer[:BGZF_BLOCK_SIZE])))
+                del buffer[:BGZF_BLOCK_SIZE]
+        if buffer:
+            bam.write(bgzf_block(bytes(buffer)))
+        bam.write(BGZF_EOF)
+
+
+def generate(directory: Path, scale: float, seed: int):
+    directory.mkdir(parents=True, exist_ok=True)
+    counts = {name: max(1, int(count * scale))
+              for name, count in PROFILES.items()}
+    write_fastq(directory / "short-read.fastq.gz",
+                illumina_reads(random.Random(seed), counts["short-read"], 1))
+    write_fastq(directory / "long-read.fastq.gz",
+                nanopore_reads(random.Random(seed), counts["long-read"]))
+    # Both mates use the same seed for the same fragments and read names.
+    write_fastq(directory / "paired_R1.fastq.gz",
+                illumina_reads(random.Random(seed), counts["paired"], 1))
+    write_fastq(directory / "paired_R2.fastq.gz",
+                illumina_reads(random.Random(seed), counts["paired"], 2))
+    write_ubam(directory / "ubam.bam",
+               nanopore_reads(random.Random(seed), counts["ubam"]))
+
+
+def default_corpora(directory: Path) -> Dict[str, List[str]]:
+    return {
+        "short-read": [str(directory / "short-read.fastq.gz")],
+        "long-read": [str(directory / "long-read.fastq.gz")],
+        "paired": [str(directory / "paired_R1.fastq.gz"),
+                   str(directory / "paired_R2.fastq.gz")],
+        "ubam": [str(directory / "ubam.bam")],
+    }
+
+
+def peak_rss_bytes() -> int:
+    # ru_maxrss is in bytes on macOS and in kilobytes elsewhere.
+    maxrss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    return maxrss if sys.platform == "darwin" else maxrss * 1024
+
+
+def measure_modules(paths: List[str]) -> List[Dict[str, Any]]:
+    """
+    Time each module's add_record_array or add_record_array_pair. Only the
+    module calls are timed, so parsing is not included. The batches are read
+    one by one rather than up front, so the peak memory is that of the
+    modules rather than that of the corpus.
+    """
+    from sequali.__main__ import (SampleMetrics, argument_parser,
+                                  set_default_fingerprint_offsets)
+    from sequali.adapters import adapters_from_file
+    from sequali.util import NGSFile
+
+    args = argument_parser().parse_args(paths)
+    paired = len(paths) == 2
+    set_default_fingerprint_offsets(args, paired)
+    seconds: Dict[str, float] = {}
+    reads = 0
+    number_of_bytes = 0
+    with contextlib.ExitStack() as exit_stack:
+        reader = exit_stack.enter_context(NGSFile(paths[0]))
+        seqtech = reader.sequencing_technology
+        if paired:
+            seqtech = "illumina"
+            mate = exit_stack.enter_context(NGSFile(paths[1]))
+            batches: Iterator[Tuple[Any, Any]] = reader.iter_mates(mate)
+        else:
+            batches = ((record_array, None) for record_array in reader)
+        adapters = list(adapters_from_file(args.adapter_file, seqtech))
+        sample = SampleMetrics(args, adapters, seqtech, paired, threads=1)
+        read2_modules = (sample.metrics2, sample.per_tile_quality2,
+                         sample.overrepresented_sequences2)
+        # Modules are called in the same order as the pipeline does, so
+        # NanoStats sees the error rates that QCMetrics sets on the record
+        # arrays.
+        for record_array1, record_array2 in batches:
+            for module in sample.modules():
+                name = sample.module_name(module)
+                start = time.perf_counter()
+                if module is sample.dedup_estimator and paired:
+                    module.add_record_array_pair(record_array1,
+                                                 record_array2)
+                elif module is sample.insert_size_metrics:
+                    module.add_record_array_pair(record_array1,
+                                                 record_array2)
+                elif any(module is read2 for read2 in read2_modules):
+                    module.add_record_array(record_array2)
+                else:
+                    module.add_record_array(record_array1)
+                seconds[name] = seconds.get(name, 0.0) + (
+                    time.perf_counter() - start)
+            reads += len(record_array1)
+            number_of_bytes += sum(
+                len(view.sequence()) * 2 + len(view.name()) + 6
+                for view in record_array1)
+    return [{"benchmark": name, "seconds": module_seconds, "reads": reads,
+             "bytes": number_of_bytes} for name, module_seconds
+            in seconds.items()]
+
+
+def measure_cli(paths: List[str], threads: int) -> List[Dict[str, Any]]:
+    from sequali.__main__ import main
+
+    sys.argv = ["sequali", "--no-report", "--threads", str(threads), *paths]
+    start = time.perf_counter()
+    main()
+    seconds = time.perf_counter() - start
+    number_of_bytes = 0
+    for path in paths:
+        opener = open if path.endswith(".bam") else gzip.open
+        with opener(path, "rb") as fileobj:
+            while block := fileobj.read(1024 * 1024):
+                number_of_bytes += len(block)
+    return [{"benchmark": f"cli --threads {threads}", "seconds": seconds,
+             "reads": None, "bytes": number_of_bytes}]
+
+
+def measure(kind: str, paths: List[str], threads: int):
+    """Run in a child process and print the results as JSON."""
+    from sequali._qc import simd_variants
+
+    if kind == "modules":
+        results = measure_modules(paths)
+    else:
+        results = measure_cli(paths, threads)
+    rss = peak_rss_bytes()
+    for result in results:
+        result["peak_rss"] = rss
+        result["simd_variants"] = simd_variants()
+    json.dump(results, sys.stdout)
+
+
+def run_measurement(kind: str, paths: List[str], threads: int,
+                    variant: str) -> List[Dict[str, Any]]:
+    env = dict(os.environ, SEQUALI_SIMD=variant)
+    process = subprocess.run(
+        [sys.executable, __file__, "_measure", kind, str(threads), *paths],
+        env=env, check=True, stdout=subprocess.PIPE)
+    return json.loads(process.stdout)
+
+
+def run(corpora: Dict[str, List[str]], variants: List[str], repeat: int,
+        threads: int, kinds: List[str]) -> List[Dict[str, Any]]:
+    results = []
+    for corpus, paths in corpora.items():
+        for variant in variants:
+            for kind in kinds:
+                # The fastest repetition is the least disturbed by other
+                # processes on the machine.
+                best: Dict[str, Dict[str, Any]] = {}
+                for _ in range(repeat):
+                    for result in run_measurement(kind, paths, threads,
+                                                  variant):
+                        name = result["benchmark"]
+                        if (name not in best or
+                                result["seconds"] < best[name]["seconds"]):
+                            best[name] = result
+                for result in best.values():
+                    result["corpus"] = corpus
+                    result["variant"] = variant
+                    results.append(result)
+                    print_result(result)
+    return results
+
+
+def result_key(result: Dict[str, Any]) -> Tuple[str, str, str]:
+    return result["corpus"], result["variant"], result["benchmark"]
+
+
+def print_result(result: Dict[str, Any]):
+    seconds = result["seconds"]
+    reads_per_second = (f"{result['reads'] / seconds:>14,.0f} reads/s"
+                        if result["reads"] else " " * 22)
+    print(f"{result['corpus']:<12} {result['variant']:<8} "
+          f"{result['benchmark']:<34} {seconds:>9.3f} s "
+          f"{reads_per_second} "
+          f"{result['bytes'] / seconds / 1e9:>7.3f} GB/s "
+          f"{result['peak_rss'] / 1024 ** 2:>8.1f} MiB",
+          file=sys.stderr)
+
+
+def compare(results: List[Dict[str, Any]], baseline: List[Dict[str, Any]],
+            tolerance: float) -> bool:
+    """Print the ratios to the baseline, return False on a regression."""
+    baseline_by_key = {result_key(result): result for result in baseline}
+    regressed = False
+    for result in results:
+        old = baseline_by_key.get(result_key(result))
+        if old is None:
+            continue
+        ratio = result["seconds"] / old["seconds"]
+        status = "ok"
+        if ratio > 1 + tolerance:
+            status = "REGRESSION"
+            regressed = True
+        corpus, variant, benchmark = result_key(result)
+        print(f"{corpus:<12} {variant:<8} {benchmark:<34} "
+              f"{old['seconds']:>9.3f} s -> {result['seconds']:>9.3f} s "
+              f"{ratio:>6.2f}x {status}")
+    return not regressed
+
+
+def parse_corpus(argument: str) -> Tuple[str, List[str]]:
+    name, sep, paths = argument.partition("=")
+    if not sep or not paths:
+        raise argparse.ArgumentTypeError(
+            f"Expected NAME=PATH[,PATH2], got {argument!r}")
+    return name, paths.split(",")
+
+
+def argument_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    subparsers = parser.add_subparsers(dest="command", required=True)
+    generate_parser = subparsers.add_parser(
+        "generate", help="Write the synthetic corpora.")
+    generate_parser.add_argument("directory", type=Path)
+    generate_parser.add_argument(
+        "--scale", type=float, default=1.0,
+        help="Multiply the number of reads of each profile. Default: 1.0.")
+    generate_parser.add_argument("--seed", type=int, default=0)
+    run_parser = subparsers.add_parser("run", help="Run the benchmarks.")
+    run_parser.add_argument(
+        "directory", type=Path, nargs="?",
+        help="Directory with the generated corpora.")
+    run_parser.add_argument(
+        "--corpus", type=parse_corpus, action="append", default=[],
+        metavar="NAME=PATH[,PATH2]",
+        help="Additional input files. Can be given multiple times.")
+    run_parser.add_argument(
+        "--variant", choices=SIMD_VARIANTS, action="append",
+        help="SIMD dispatch variant to benchmark. Can be given multiple "
+             "times. Default: all variants.")
+    run_parser.add_argument(
+        "--benchmarks", choices=("modules", "cli"), action="append",
+        help="Benchmark the modules in isolation or the end-to-end command "
+             "line. Default: both.")
+    run_parser.add_argument("--threads", type=int, default=1,
+                            help="Threads for the cli benchmark. Default: 1.")
+    run_parser.add_argument("--repeat", type=int, default=3,
+                            help="Keep the fastest of this many runs. "
+                                 "Default: 3.")
+    run_parser.add_argument("--output", help="Write the results as JSON.")
+    run_parser.add_argument("--baseline",
+                            help="Compare against results stored with "
+                                 "--output.")
+    run_parser.add_argument(
+        "--tolerance", type=float, default=0.10,
+        help="Fraction a benchmark may be slower than the baseline. "
+             "Default: 0.10.")
+    return parser
+
+
+def main():
+    if len(sys.argv) > 1 and sys.argv[1] == "_measure":
+        kind, threads, *paths = sys.argv[2:]
+        measure(kind, paths, int(threads))
+        return
+    args = argument_parser().parse_args()
+    if args.command == "generate":
+        generate(args.directory, args.scale, args.seed)
+        return
+    corpora = default_corpora(args.directory) if args.directory else {}
+    corpora.update(args.corpus)
+    if not corpora:
+        sys.exit("No corpora given, use a directory or --corpus.")
+    results = run(corpora, args.variant or list(SIMD_VARIANTS), args.repeat,
+                  args.threads, args.benchmarks or ["modules", "cli"])
+    if args.output:
+        with open(args.output, "wt") as output:
+            json.dump(results, output, indent=2)
+    if args.baseline:
+        with open(args.baseline, "rt") as baseline_file:
+            baseline = json.load(baseline_file)
+        if not compare(results, baseline, args.tolerance):
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -18,6 +18,7 @@ from ._qc import A, C, G, N, T
 from ._qc import (
     AdapterCounter, BamParser, FastqParser, FastqRecordArrayView,
     FastqRecordView, OverrepresentedSequences, PerTileQuality, QCMetrics,
+    QCPipeline,
 )
 from ._qc import NUMBER_OF_NUCS, NUMBER_OF_PHREDS, PHRED_MAX, TABLE_SIZE
 from ._version import __version__
@@ -32,6 +33,7 @@ __all__ = [
     "FastqRecordArrayView",
     "PerTileQuality",
     "QCMetrics",
+    "QCPipeline",
     "OverrepresentedSequences",
     "NUMBER_OF_NUCS",
     "NUMBER_OF_PHREDS",
@@ -18,7 +18,10 @@ import argparse
 import contextlib
 import json
 import os
+import re
 import sys
+import time
+from typing import Any, Dict, List, Optional, Set, Tuple
 
 
 from ._qc import (
@@ -34,17 +37,21 @@ from ._qc import (
     DEFAULT_MAX_UNIQUE_FRAGMENTS,
     DEFAULT_UNIQUE_SAMPLE_EVERY,
     DedupEstimator,
+    FastqRecordArrayView,
     InsertSizeMetrics,
     NanoStats,
     OverrepresentedSequences,
     PerTileQuality,
     QCMetrics,
+    QCPipeline,
+    simd_variants,
 )
 from ._version import __version__
-from .adapters import DEFAULT_ADAPTER_FILE, adapters_from_file
-from .report_modules import (calculate_stats, dict_to_report_modules,
+from .adapters import Adapter, DEFAULT_ADAPTER_FILE, adapters_from_file
+from .report_modules import (Meta, ProfileReport, READ2, Summary,
+                             calculate_stats, dict_to_report_modules,
                              report_modules_to_dict, write_html_report)
-from .util import NGSFile, sequence_names_match
+from .util import NGSFile, STDIN_PATH
 
 DEFAULT_FINGERPRINT_BACK_SEQUENCE_PAIRED_OFFSET = 0
 DEFAULT_FINGERPRINT_FRONT_SEQUENCE_PAIRED_OFFSET = 0
@@ -54,12 +61,17 @@ def argument_parser() -> argparse.ArgumentParser:
     parser = argparse.ArgumentParser(
         description="Create a quality metrics report for sequencing data.")
     parser.add_argument("input", metavar="INPUT",
-                        help="Input FASTQ or uBAM file. "
+                        help="Input FASTQ or uBAM file. Use '-' for stdin. "
                              "The format is autodetected and compressed "
-                             "formats are supported.")
+                             "formats are supported. Multiple files from "
+                             "the same sample can be given as a "
+                             "comma-separated list. These are reported "
+                             "together.")
     parser.add_argument("input_reverse", metavar="INPUT_REVERSE",
                         nargs="?",
-                        help="Second FASTQ file for Illumina paired-end reads."
+                        help="Second FASTQ file for Illumina paired-end reads. "
+                             "When INPUT is a list, this should be a list of "
+                             "the mates in the same order."
                         )
     parser.add_argument("--json",
                         help="JSON output file. default: '<input>.json'.")
@@ -74,6 +86,30 @@ def argument_parser() -> argparse.ArgumentParser:
                         help=f"File with adapters to search for. See default "
                              f"file for formatting. "
                              f"Default: {DEFAULT_ADAPTER_FILE}.")
+    parser.add_argument("--adapter-bases-from-start", type=int,
+                        default=-1,
+                        metavar="BP",
+                        help="Only search for adapters in this many bases "
+                             "from the start of the read and the bases set "
+                             "by --adapter-bases-from-end. When only this "
+                             "option is set, only the start of the read is "
+                             "searched. Useful for very long reads. Set to a "
+                             "negative value to search the entire read. "
+                             "Default: -1")
+    parser.add_argument("--adapter-bases-from-end", type=int,
+                        default=-1,
+                        metavar="BP",
+                        help="Only search for adapters in this many bases "
+                             "from the end of the read and the bases set "
+                             "by --adapter-bases-from-start. When only this "
+                             "option is set, only the end of the read is "
+                             "searched. Set to a negative value to search "
+                             "the entire read. Default: -1")
+    parser.add_argument("--adapter-sample-every", type=int,
+                        default=1,
+                        metavar="DIVISOR",
+                        help="Only search for adapters in 1 in DIVISOR "
+                             "reads. Default: 1 (every read).")
     parser.add_argument("--overrepresentation-threshold-fraction",
                         metavar="FRACTION",
                         type=float,
@@ -106,6 +142,20 @@ def argument_parser() -> argparse.ArgumentParser:
                              f"of finding overrepresented sequences at the "
                              f"cost of increasing memory usage. Default: "
                              f"{DEFAULT_MAX_UNIQUE_FRAGMENTS:,}.")
+    parser.add_argument("--overrepresentation-sketch-memory", type=int,
+                        default=0,
+                        metavar="MIB",
+                        help="Count the fragments approximately in a "
+                             "count-min sketch of this many MiB, keeping the "
+                             "most common fragments, rather than exactly. "
+                             "The memory does not grow with the input and "
+                             "there is no bias towards the beginning of the "
+                             "file, at the cost of counts that can be "
+                             "overestimated. Each thread that counts reads "
+                             "has its own sketch, so up to --threads + 1 "
+                             "sketches are used, one for each read of a "
+                             "pair, and one more for each file or read group "
+                             "with --split-by. Default: 0 (count exactly).")
     parser.add_argument("--overrepresentation-fragment-length", type=int,
                         metavar="LENGTH",
                         default=DEFAULT_FRAGMENT_LENGTH,
@@ -178,39 +228,324 @@ def argument_parser() -> argparse.ArgumentParser:
                              f"for single end, "
                              f"{DEFAULT_FINGERPRINT_BACK_SEQUENCE_PAIRED_OFFSET} "
                              f"for paired sequences.")
+    parser.add_argument("--split-by", choices=("file", "read-group"),
+                        help="Also write a report for each input file or "
+                             "for each read group (the RG tag in uBAM "
+                             "files). The file or read group name is added "
+                             "to the report name before the extension. The "
+                             "combined report is created by merging these, "
+                             "so the reads are only read once.")
+    parser.add_argument("--snapshot", metavar="FILE",
+                        help="Periodically write a JSON summary of the reads "
+                             "processed so far to FILE. Useful for "
+                             "monitoring data that is still being written, "
+                             "for instance when reading from a pipe.")
+    parser.add_argument("--snapshot-every-reads", type=int, metavar="N",
+                        help="Write a snapshot after every N reads. "
+                             "Default: not based on the number of reads.")
+    parser.add_argument("--snapshot-every-seconds", type=float,
+                        metavar="SECONDS", default=60.0,
+                        help="Write a snapshot when this many seconds have "
+                             "passed since the last one. Set to 0 to only "
+                             "use --snapshot-every-reads. Default: 60.")
+    parser.add_argument("--profile", action="store_true",
+                        help="Measure the time spent reading, parsing, in "
+                             "each module and on the report, and add it to "
+                             "the report together with hash table and CPU "
+                             "dispatch statistics.")
     parser.add_argument("-t", "--threads", type=int, default=2,
                         help="Number of threads to use. If greater than one "
                              "an additional thread for gzip "
-                             "decompression will be used. Default: 2.")
+                             "decompression will be used. The remaining "
+                             "threads are used for processing single end "
+                             "data. Default: 2.")
     parser.add_argument("--version", action="version",
                         version=__version__)
-    # Option to skip report creation and only run the module data gathering.
-    # For benchmarking purposes.
     parser.add_argument("--no-report", action="store_true",
-                        help=argparse.SUPPRESS)
+                        help="Only gather the module data and do not write "
+                             "the JSON and HTML reports. Useful for "
+                             "benchmarking.")
     return parser
 
 
-def main() -> None:
-    args = argument_parser().parse_args()
-    threads = args.threads
-    if threads < 1:
-        raise ValueError(f"Threads must be greater than 1, got {threads}.")
+class SampleMetrics:
+    """The modules that gather the metrics for one report."""
 
-    fraction_threshold = args.overrepresentation_threshold_fraction
-    max_threshold = args.overrepresentation_max_threshold
-    # if max_threshold is set it needs to be lower than min threshold
-    min_threshold = min(args.overrepresentation_min_threshold, max_threshold)
-    paired = bool(args.input_reverse)
-
-    metrics1 = QCMetrics()
-    per_tile_quality1 = PerTileQuality()
-    nanostats1 = NanoStats()
-    overrepresented_sequences1 = OverrepresentedSequences(
-        max_unique_fragments=args.overrepresentation_max_unique_fragments,
-        fragment_length=args.overrepresentation_fragment_length,
-        sample_every=args.overrepresentation_sample_every
-    )
+    def __init__(self, args: argparse.Namespace, adapters: List[Adapter],
+                 seqtech: Optional[str], paired: bool, threads: int,
+                 serial: bool = False):
+        self.seqtech = seqtech
+        self.threads = threads
+        # Serial samples run the modules on the calling thread rather than
+        # in a QCPipeline, so they do not start threads or copy modules.
+        self.serial = serial
+        self.paired = paired
+        self.profile: bool = args.profile
+        # Seconds per module name, only counted when profiling.
+        self.module_times: Dict[str, float] = {}
+        self.metrics1 = QCMetrics()
+        self.per_tile_quality1 = PerTileQuality()
+        self.nanostats1 = NanoStats()
+        self.overrepresented_sequences1 = OverrepresentedSequences(
+            max_unique_fragments=args.overrepresentation_max_unique_fragments,
+            fragment_length=args.overrepresentation_fragment_length,
+            sample_every=args.overrepresentation_sample_every,
+            sketch_memory=args.overrepresentation_sketch_memory * 1024 * 1024,
+        )
+        self.dedup_estimator = DedupEstimator(
+            max_stored_fingerprints=args.duplication_max_stored_fingerprints,
+            front_sequence_length=args.fingerprint_front_length,
+            front_sequence_offset=args.fingerprint_front_offset,
+            back_sequence_length=args.fingerprint_back_length,
+            back_sequence_offset=args.fingerprint_back_offset,
+        )
+        self.adapter_counter1: Optional[AdapterCounter] = None
+        self.insert_size_metrics: Optional[InsertSizeMetrics] = None
+        self.metrics2: Optional[QCMetrics] = None
+        self.per_tile_quality2: Optional[PerTileQuality] = None
+        self.overrepresented_sequences2: Optional[
+            OverrepresentedSequences] = None
+        if paired:
+            self.insert_size_metrics = InsertSizeMetrics()
+            self.metrics2 = QCMetrics()
+            self.per_tile_quality2 = PerTileQuality()
+            self.overrepresented_sequences2 = OverrepresentedSequences(
+                max_unique_fragments=(
+                    args.overrepresentation_max_unique_fragments),
+                fragment_length=args.overrepresentation_fragment_length,
+                sample_every=args.overrepresentation_sample_every,
+                sketch_memory=(
+                    args.overrepresentation_sketch_memory * 1024 * 1024),
+            )
+        else:
+            self.adapter_counter1 = AdapterCounter(
+                (adapter.sequence for adapter in adapters),
+                bases_from_start=args.adapter_bases_from_start,
+                bases_from_end=args.adapter_bases_from_end,
+                sample_every=args.adapter_sample_every,
+            )
+        # The pipeline starts its threads, so it is only created once there
+        # are reads to process.
+        self.pipeline: Optional[QCPipeline] = None
+
+    def modules(self) -> List[Any]:
+        return [module for module in (
+            self.metrics1, self.per_tile_quality1,
+            self.overrepresented_sequences1, self.nanostats1,
+            self.adapter_counter1, self.dedup_estimator,
+            self.insert_size_metrics, self.metrics2, self.per_tile_quality2,
+            self.overrepresented_sequences2) if module is not None]
+
+    def module_name(self, module: Any) -> str:
+        name = type(module).__name__
+        if any(module is read2_module for read2_module in (
+                self.metrics2, self.per_tile_quality2,
+                self.overrepresented_sequences2)):
+            name += " read 2"
+        return name
+
+    def add_module_time(self, module: Any, seconds: float):
+        name = self.module_name(module)
+        self.module_times[name] = self.module_times.get(name, 0.0) + seconds
+
+    def add_record_array(self, record_array: FastqRecordArrayView):
+        if self.serial:
+            self._add_record_array_serial(record_array)
+            return
+        if self.pipeline is None:
+            # QCMetrics must come before NanoStats as it sets the
+            # accumulated error rate that NanoStats uses. Long nanopore reads
+            # are expensive per read for all modules, so the modules are
+            # divided over the threads rather than the reads. This avoids
+            # merging the large hash tables.
+            self.pipeline = QCPipeline(
+                [self.metrics1, self.per_tile_quality1,
+                 self.overrepresented_sequences1, self.nanostats1,
+                 self.adapter_counter1, self.dedup_estimator],
+                threads=max(self.threads - 1, 1),
+                split_modules=self.seqtech == "nanopore",
+                profile=self.profile)
+        self.pipeline.add_record_array(record_array)
+
+    def _add_record_array_serial(self, record_array: FastqRecordArrayView):
+        # Same order as the pipeline, so NanoStats can use the error rates
+        # set by QCMetrics.
+        for module in (self.metrics1, self.per_tile_quality1,
+                       self.overrepresented_sequences1, self.nanostats1,
+                       self.adapter_counter1, self.dedup_estimator):
+            if not self.profile:
+                module.add_record_array(record_array)  # type: ignore
+                continue
+            start = time.perf_counter()
+            module.add_record_array(record_array)  # type: ignore
+            self.add_module_time(module, time.perf_counter() - start)
+
+    def add_record_array_pair(self, record_array1: FastqRecordArrayView,
+                              record_array2: FastqRecordArrayView):
+        if self.profile:
+            self._add_record_array_pair_profiled(record_array1, record_array2)
+            return
+        self.metrics1.add_record_array(record_array1)
+        self.per_tile_quality1.add_record_array(record_array1)
+        self.overrepresented_sequences1.add_record_array(record_array1)
+        self.nanostats1.add_record_array(record_array1)
+        self.dedup_estimator.add_record_array_pair(record_array1, record_array2)
+        self.insert_size_metrics.add_record_array_pair(record_array1, record_array2)  # type: ignore  # noqa: E501
+        self.metrics2.add_record_array(record_array2)  # type: ignore
+        self.per_tile_quality2.add_record_array(record_array2)  # type: ignore
+        self.overrepresented_sequences2.add_record_array(record_array2)  # type: ignore  # noqa: E501
+
+    def _add_record_array_pair_profiled(
+            self, record_array1: FastqRecordArrayView,
+            record_array2: FastqRecordArrayView):
+        # Same order as add_record_array_pair, so NanoStats can use the
+        # error rates set by QCMetrics.
+        pair = (record_array1, record_array2)
+        module_calls: List[Tuple[Any, str, Tuple[Any, ...]]] = [
+            (self.metrics1, "add_record_array", (record_array1,)),
+            (self.per_tile_quality1, "add_record_array", (record_array1,)),
+            (self.overrepresented_sequences1, "add_record_array",
+             (record_array1,)),
+            (self.nanostats1, "add_record_array", (record_array1,)),
+            (self.dedup_estimator, "add_record_array_pair", pair),
+            (self.insert_size_metrics, "add_record_array_pair", pair),
+            (self.metrics2, "add_record_array", (record_array2,)),
+            (self.per_tile_quality2, "add_record_array", (record_array2,)),
+            (self.overrepresented_sequences2, "add_record_array",
+             (record_array2,)),
+        ]
+        for module, method, record_arrays in module_calls:
+            start = time.perf_counter()
+            getattr(module, method)(*record_arrays)
+            self.add_module_time(module, time.perf_counter() - start)
+
+    def sync_metrics(self):
+        """Make sure the QCMetrics include all reads added so far."""
+        if self.pipeline is not None:
+            self.pipeline.sync([self.metrics1])
+
+    def finish(self):
+        if self.pipeline is not None:
+            self.pipeline.finish()
+            if self.profile:
+                for module, seconds in zip(self.pipeline.modules,
+                                           self.pipeline.module_times()):
+                    self.add_module_time(module, seconds)
+                # Do not count the times again when finish is called twice.
+                self.profile = False
+
+    def merge(self, other: "SampleMetrics"):
+        """Add the metrics of another, finished, SampleMetrics object."""
+        for module, other_module in zip(self.modules(), other.modules()):
+            module.merge(other_module)
+        for name, seconds in other.module_times.items():
+            self.module_times[name] = (
+                self.module_times.get(name, 0.0) + seconds)
+
+    def hash_table_stats(self) -> Dict[str, Dict[str, float]]:
+        stats = {
+            "OverrepresentedSequences":
+                self.overrepresented_sequences1.hash_table_stats(),
+            "DedupEstimator": self.dedup_estimator.hash_table_stats(),
+        }
+        if self.overrepresented_sequences2 is not None:
+            stats["OverrepresentedSequences read 2"] = (
+                self.overrepresented_sequences2.hash_table_stats())
+        return stats
+
+
+class Profiler:
+    """
+    Collect where the time of a run is spent for the --profile report
+    section. The parsers and the modules count their own time, so the
+    profiler only has to add up the counters.
+    """
+
+    def __init__(self, threads: int):
+        self.threads = threads
+        self.start_time = time.perf_counter()
+        self.read_seconds = 0.0
+        self.parse_seconds = 0.0
+        self.reads = 0
+        self.bytes = 0
+
+    def add_file(self, ngs_file: NGSFile):
+        # Reading is counted by the parser while it parses, so it is split
+        # off from the parse time.
+        self.read_seconds += ngs_file.read_seconds
+        self.parse_seconds += ngs_file.parse_seconds - ngs_file.read_seconds
+        self.reads += ngs_file.number_of_records
+        self.bytes += ngs_file.number_of_bytes
+
+    def report(self, sample: SampleMetrics,
+               report_seconds: float) -> ProfileReport:
+        return ProfileReport(
+            sequencing_technology=sample.seqtech,
+            threads=self.threads,
+            wall_time=time.perf_counter() - self.start_time,
+            reads=self.reads,
+            bytes=self.bytes,
+            stage_times={
+                "Reading and decompression": self.read_seconds,
+                "Parsing": self.parse_seconds,
+                "Modules": sum(sample.module_times.values()),
+                "Report statistics": report_seconds,
+            },
+            module_times=dict(sample.module_times),
+            hash_tables=sample.hash_table_stats(),
+            simd_variants=simd_variants(),
+        )
+
+
+class SnapshotWriter:
+    """
+    Write a JSON summary of the reads processed so far, after a number of
+    reads or seconds. Only the QCMetrics are synchronized and summarized, so
+    the cost of a snapshot does not grow with the number of reads.
+    """
+
+    def __init__(self, path: str, every_reads: Optional[int],
+                 every_seconds: Optional[float], filenames: List[str],
+                 filenames_reverse: List[str]):
+        self.path = path
+        self.every_reads = every_reads
+        self.every_seconds = every_seconds
+        self.filenames = filenames
+        self.filenames_reverse = filenames_reverse
+        self.reads_since_snapshot = 0
+        self.last_snapshot_time = time.monotonic()
+
+    def update(self, sample: SampleMetrics, number_of_reads: int):
+        self.reads_since_snapshot += number_of_reads
+        if self.every_reads and self.reads_since_snapshot >= self.every_reads:
+            self.write(sample)
+        elif (self.every_seconds and time.monotonic() -
+                self.last_snapshot_time >= self.every_seconds):
+            self.write(sample)
+
+    def write(self, sample: SampleMetrics, finished: bool = False):
+        sample.sync_metrics()
+        snapshot: Dict[str, Any] = {
+            "finished": finished,
+            "meta": Meta.from_filepath(self.filenames,
+                                       self.filenames_reverse).to_dict(),
+            "summary": Summary.from_qc_metrics(sample.metrics1).to_dict(),
+        }
+        if sample.metrics2 is not None:
+            snapshot["summary_read2"] = Summary.from_qc_metrics(
+                sample.metrics2, read_pair_info=READ2).to_dict()
+        # Replace the previous snapshot atomically, so a reader never sees
+        # a partially written file.
+        temporary_path = self.path + ".tmp"
+        with open(temporary_path, "wt") as snapshot_file:
+            json.dump(snapshot, snapshot_file, indent=0)
+        os.replace(temporary_path, self.path)
+        self.reads_since_snapshot = 0
+        self.last_snapshot_time = time.monotonic()
+
+
+def set_default_fingerprint_offsets(args: argparse.Namespace, paired: bool):
+    """The default fingerprint offsets depend on whether data is paired."""
     if paired:
         if args.fingerprint_front_offset is None:
             args.fingerprint_front_offset = (
@@ -225,114 +560,244 @@ def main() -> None:
         if args.fingerprint_back_offset is None:
             args.fingerprint_back_offset = (
                 DEFAULT_FINGERPRINT_BACK_SEQUENCE_PAIRED_OFFSET)
-    dedup_estimator = DedupEstimator(
-        max_stored_fingerprints=args.duplication_max_stored_fingerprints,
-        front_sequence_length=args.fingerprint_front_length,
-        front_sequence_offset=args.fingerprint_front_offset,
-        back_sequence_length=args.fingerprint_back_length,
-        back_sequence_offset=args.fingerprint_back_offset,
-    )
 
-    if paired:
-        insert_size_metrics = InsertSizeMetrics()
-        metrics2 = QCMetrics()
-        per_tile_quality2 = PerTileQuality()
-        overrepresented_sequences2 = OverrepresentedSequences(
-            max_unique_fragments=args.overrepresentation_max_unique_fragments,
-            fragment_length=args.overrepresentation_fragment_length,
-            sample_every=args.overrepresentation_sample_every
-        )
-    else:
-        metrics2 = None
-        per_tile_quality2 = None
-        overrepresented_sequences2 = None
-        insert_size_metrics = None
-    with contextlib.ExitStack() as exit_stack:
-        reader1 = NGSFile(args.input, threads - 1)
-        exit_stack.enter_context(reader1)
-        seqtech = reader1.sequencing_technology
-        if paired:
-            reader2 = NGSFile(args.input_reverse, threads - 1)
-            exit_stack.enter_context(reader2)
-            if reader1.sequencing_technology != reader2.sequencing_technology:
-                raise RuntimeError(
-                    f"Mismatching sequencing technologies:\n"
-                    f"{reader1.filepath}: {reader1.sequencing_technology}\n"
-                    f"{reader2.filepath}: {reader2.sequencing_technology}\n")
-            if not (reader1.format == "FASTQ" and reader2.format == "FASTQ"):
-                raise RuntimeError("Paired end mode is only supported for "
-                                   "FASTQ files.")
-            seqtech = "illumina"  # Paired end is always illumina
-            adapter_counter1 = None
-        adapters = list(adapters_from_file(args.adapter_file, seqtech))
-        if not paired:
-            adapter_counter1 = AdapterCounter(
-                adapter.sequence for adapter in adapters)
-        for record_array1 in reader1:
-            metrics1.add_record_array(record_array1)
-            per_tile_quality1.add_record_array(record_array1)
-            overrepresented_sequences1.add_record_array(record_array1)
-            nanostats1.add_record_array(record_array1)
-            if paired:
-                record_array2 = reader2.read(len(record_array1))
-                if len(record_array1) != len(record_array2):
-                    raise RuntimeError(
-                        f"FASTQ Files out of sync {args.input} has more "
-                        f"FASTQ records than {args.input_reverse}.")
-                if not (record_array1.is_mate(record_array2)):
-                    for r1, r2 in zip(iter(record_array1),
-                                      iter(record_array2)):
-                        if not sequence_names_match(r1.name(),
-                                                    r2.name()):
-                            raise RuntimeError(
-                                f"Mismatching names found! {r1.name()} "
-                                f"{r2.name()}")
-                    raise RuntimeError("Mismatching names found!")
-                dedup_estimator.add_record_array_pair(record_array1, record_array2)
-                insert_size_metrics.add_record_array_pair(record_array1, record_array2)  # type: ignore  # noqa: E501
-                metrics2.add_record_array(record_array2)  # type: ignore  # noqa: E501
-                per_tile_quality2.add_record_array(record_array2)  # type: ignore  # noqa: E501
-                overrepresented_sequences2.add_record_array(record_array2)  # type: ignore  # noqa: E501
-            else:
-                adapter_counter1.add_record_array(record_array1)   # type: ignore  # noqa: E501
-                dedup_estimator.add_record_array(record_array1)
-        if paired and len(reader2.read(1)) > 0:
-            raise RuntimeError(
-                f"FASTQ Files out of sync {args.input_reverse} has "
-                f"more FASTQ records than {args.input}.")
-    if args.no_report:
-        return
+
+def split_input_argument(argument: Optional[str]) -> List[str]:
+    """
+    Split a comma-separated list of input files. An existing path is
+    returned as is, so names that contain a comma can still be used.
+    """
+    if argument is None:
+        return []
+    if os.path.exists(argument):
+        return [argument]
+    return argument.split(",")
+
+
+def group_report_path(path: str, group_name: str) -> str:
+    """Insert the group name before the extension of a report path."""
+    root, ext = os.path.splitext(path)
+    return f"{root}.{group_name}{ext}"
+
+
+def unique_group_name(name: str, used_names: Set[str]) -> str:
+    """Make a name that is safe to use in a filename and not used yet."""
+    safe_name = re.sub(r"[^\w.-]", "_", name)
+    unique_name = safe_name
+    number = 1
+    while unique_name in used_names:
+        number += 1
+        unique_name = f"{safe_name}_{number}"
+    used_names.add(unique_name)
+    return unique_name
+
+
+def write_report(sample: SampleMetrics,
+                 args: argparse.Namespace,
+                 json_path: str,
+                 html_path: str,
+                 filenames: List[str],
+                 filenames_reverse: List[str],
+                 adapters: List[Adapter],
+                 read_group: Optional[str] = None,
+                 profiler: Optional[Profiler] = None):
+    start_time = time.perf_counter()
+    fraction_threshold = args.overrepresentation_threshold_fraction
+    max_threshold = args.overrepresentation_max_threshold
+    # if max_threshold is set it needs to be lower than min threshold
+    min_threshold = min(args.overrepresentation_min_threshold, max_threshold)
     report_modules = calculate_stats(
-        filename=args.input,
-        metrics=metrics1,
-        adapter_counter=adapter_counter1,
-        per_tile_quality=per_tile_quality1,
-        sequence_duplication=overrepresented_sequences1,
-        dedup_estimator=dedup_estimator,
-        nanostats=nanostats1,
-        insert_size_metrics=insert_size_metrics,
-        filename_reverse=args.input_reverse,
-        metrics_reverse=metrics2,
-        per_tile_quality_reverse=per_tile_quality2,
-        sequence_duplication_reverse=overrepresented_sequences2,
+        filename=filenames,
+        metrics=sample.metrics1,
+        adapter_counter=sample.adapter_counter1,
+        per_tile_quality=sample.per_tile_quality1,
+        sequence_duplication=sample.overrepresented_sequences1,
+        dedup_estimator=sample.dedup_estimator,
+        nanostats=sample.nanostats1,
+        insert_size_metrics=sample.insert_size_metrics,
+        filename_reverse=filenames_reverse or None,
+        metrics_reverse=sample.metrics2,
+        per_tile_quality_reverse=sample.per_tile_quality2,
+        sequence_duplication_reverse=sample.overrepresented_sequences2,
         adapters=adapters,
         fraction_threshold=fraction_threshold,
         min_threshold=min_threshold,
-        max_threshold=max_threshold)
-    os.makedirs(args.outdir, exist_ok=True)
+        max_threshold=max_threshold,
+        threads=args.threads,
+        read_group=read_group)
+    if profiler is not None:
+        report_modules.append(profiler.report(
+            sample, time.perf_counter() - start_time))
+    with open(json_path, "wt") as json_file:
+        json_dict = report_modules_to_dict(report_modules)
+        # Indent=0 is ~40% smaller than indent=2 while still human-readable
+        json.dump(json_dict, json_file, indent=0)
+    write_html_report(report_modules, html_path)
+
+
+def main() -> None:
+    args = argument_parser().parse_args()
+    threads = args.threads
+    if threads < 1:
+        raise ValueError(f"Threads must be greater than 1, got {threads}.")
+
+    inputs = split_input_argument(args.input)
+    inputs_reverse = split_input_argument(args.input_reverse)
+    paired = bool(inputs_reverse)
+    if paired and len(inputs) != len(inputs_reverse):
+        raise ValueError(
+            f"The number of input files should be the same for both reads. "
+            f"Got {len(inputs)} files for read 1 and {len(inputs_reverse)} "
+            f"files for read 2.")
+    split_by = args.split_by
+    if split_by == "read-group" and paired:
+        raise ValueError("Splitting by read group is only supported for BAM "
+                         "files, which can not be paired.")
+    if split_by and args.snapshot:
+        raise ValueError("Snapshots can not be combined with --split-by.")
+    set_default_fingerprint_offsets(args, paired)
+
+    report_name = ("stdin" if inputs[0] == STDIN_PATH
+                   else os.path.basename(inputs[0]))
     if args.json is None:
-        args.json = os.path.basename(args.input) + ".json"
+        args.json = report_name + ".json"
     if args.html is None:
-        args.html = os.path.basename(args.input) + ".html"
+        args.html = report_name + ".html"
     if not os.path.isabs(args.json):
         args.json = os.path.join(args.outdir, args.json)
     if not os.path.isabs(args.html):
         args.html = os.path.join(args.outdir, args.html)
-    with open(args.json, "wt") as json_file:
-        json_dict = report_modules_to_dict(report_modules)
-        # Indent=0 is ~40% smaller than indent=2 while still human-readable
-        json.dump(json_dict, json_file, indent=0)
-    write_html_report(report_modules, args.html)
+    snapshot_writer: Optional[SnapshotWriter] = None
+    if args.snapshot:
+        if not os.path.isabs(args.snapshot):
+            args.snapshot = os.path.join(args.outdir, args.snapshot)
+        snapshot_writer = SnapshotWriter(
+            args.snapshot, args.snapshot_every_reads,
+            args.snapshot_every_seconds, inputs, inputs_reverse)
+    if not args.no_report or snapshot_writer:
+        os.makedirs(args.outdir, exist_ok=True)
+
+    seqtech: Optional[str] = None
+    adapters: List[Adapter] = []
+    profiler = Profiler(threads) if args.profile else None
+    total: Optional[SampleMetrics] = None
+    read_groups: Dict[Optional[str], SampleMetrics] = {}
+    used_group_names: Set[str] = set()
+    for index, input1 in enumerate(inputs):
+        input2 = inputs_reverse[index] if paired else None
+        with contextlib.ExitStack() as exit_stack:
+            reader1 = NGSFile(input1, threads - 1)
+            exit_stack.enter_context(reader1)
+            file_seqtech = reader1.sequencing_technology
+            if paired:
+                reader2 = NGSFile(input2, threads - 1)  # type: ignore
+                exit_stack.enter_context(reader2)
+                if (reader1.sequencing_technology !=
+                        reader2.sequencing_technology):
+                    raise RuntimeError(
+                        f"Mismatching sequencing technologies:\n"
+                        f"{reader1.filepath}: "
+                        f"{reader1.sequencing_technology}\n"
+                        f"{reader2.filepath}: "
+                        f"{reader2.sequencing_technology}\n")
+                if not (reader1.format == "FASTQ" and
+                        reader2.format == "FASTQ"):
+                    raise RuntimeError("Paired end mode is only supported "
+                                       "for FASTQ files.")
+                file_seqtech = "illumina"  # Paired end is always illumina
+            if split_by == "read-group" and reader1.format != "BAM":
+                raise RuntimeError(
+                    f"Splitting by read group is only supported for BAM "
+                    f"files, {input1} is a {reader1.format} file.")
+            if total is None:
+                seqtech = file_seqtech
+                adapters = list(adapters_from_file(args.adapter_file,
+                                                   seqtech))
+                total = SampleMetrics(args, adapters, seqtech, paired,
+                                      threads)
+            elif file_seqtech != seqtech:
+                raise RuntimeError(
+                    f"Mismatching sequencing technologies:\n"
+                    f"{inputs[0]}: {seqtech}\n"
+                    f"{input1}: {file_seqtech}\n")
+            if split_by == "file":
+                sample = SampleMetrics(args, adapters, seqtech, paired,
+                                       threads)
+            else:
+                sample = total
+            if paired:
+                for record_array1, record_array2 in reader1.iter_mates(
+                        reader2):
+                    if len(record_array1) != len(record_array2):
+                        longer, shorter = input1, input2
+                        if len(record_array2) > len(record_array1):
+                            longer, shorter = input2, input1
+                        raise RuntimeError(
+                            f"FASTQ Files out of sync {longer} has more "
+                            f"FASTQ records than {shorter}.")
+                    sample.add_record_array_pair(record_array1,
+                                                 record_array2)
+                    if snapshot_writer:
+                        snapshot_writer.update(sample, len(record_array1))
+            else:
+                for record_array1 in reader1:
+                    if split_by == "read-group":
+                        for read_group, group_array in (
+                                record_array1.split_by_read_group().items()):
+                            group_sample = read_groups.get(read_group)
+                            if group_sample is None:
+                                # A pipeline per read group would start
+                                # threads and module copies for each of
+                                # them, so the groups are run serially.
+                                group_sample = SampleMetrics(
+                                    args, adapters, seqtech, paired, threads,
+                                    serial=True)
+                                read_groups[read_group] = group_sample
+                            group_sample.add_record_array(group_array)
+                    else:
+                        sample.add_record_array(record_array1)
+                        if snapshot_writer:
+                            snapshot_writer.update(sample,
+                                                   len(record_array1))
+            if profiler:
+                profiler.add_file(reader1)
+                if paired:
+                    profiler.add_file(reader2)
+        if split_by == "file":
+            sample.finish()
+            total.merge(sample)
+            if not args.no_report:
+                group_name = unique_group_name(os.path.basename(input1),
+                                               used_group_names)
+                write_report(sample, args,
+                             group_report_path(args.json, group_name),
+                             group_report_path(args.html, group_name),
+                             [input1], [input2] if input2 else [],
+                             adapters)
+            del sample
+    assert total is not None
+    # Write the reports of the read groups one by one, so their modules can
+    # be released as soon as they are merged and reported.
+    for read_group in list(read_groups.keys()):
+        group_sample = read_groups.pop(read_group)
+        group_sample.finish()
+        total.merge(group_sample)
+        if not args.no_report:
+            read_group_name = ("no_read_group" if read_group is None
+                               else read_group)
+            group_name = unique_group_name(read_group_name, used_group_names)
+            write_report(group_sample, args,
+                         group_report_path(args.json, group_name),
+                         group_report_path(args.html, group_name),
+                         inputs, inputs_reverse, adapters,
+                         read_group=read_group_name)
+    total.finish()
+    if snapshot_writer:
+        snapshot_writer.write(total, finished=True)
+    if args.no_report:
+        return
+    write_report(total, args, args.json, args.html, inputs, inputs_reverse,
+                 adapters, profiler=profiler)
 
 
 if __name__ == "__main__":  # pragma: no cover
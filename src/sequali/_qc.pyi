@@ -16,7 +16,8 @@
 
 import array
 import sys
-from typing import Dict, Iterable, Iterator, List, SupportsIndex, Optional, Tuple
+from typing import (Dict, Iterable, Iterator, List, SupportsIndex, Optional, Tuple,
+                    Union)
 
 TABLE_SIZE: int
 NUMBER_OF_PHREDS: int
@@ -41,8 +42,12 @@ DEFAULT_FINGERPRINT_BACK_SEQUENCE_OFFSET: int
 INSERT_SIZE_MAX_ADAPTER_STORE_SIZE: int
 
 
+class FileMapping:
+    def __len__(self) -> int: ...
+    def __bytes__(self) -> bytes: ...
+
 class FastqRecordView:
-    obj: bytes
+    obj: Union[bytes, memoryview, FileMapping]
     def __init__(self, name: str, sequence: str, qualities: str, 
                  tags: Optional[bytes] = None) -> None: ...
     def name(self) -> str: ...
@@ -51,21 +56,33 @@ class FastqRecordView:
     def tags(self) -> bytes: ...
 
 class FastqRecordArrayView:
-    obj: bytes
+    obj: Union[bytes, memoryview, FileMapping]
     def __init__(self, view_items: Iterable[FastqRecordView]) -> None: ...
     def __getitem__(self, index: SupportsIndex) -> FastqRecordView: ...
     def __len__(self) -> int: ...
     def is_mate(self, other: FastqRecordArrayView): ...
+    def split_by_read_group(
+            self) -> Dict[Optional[str], FastqRecordArrayView]: ...
 
 class FastqParser:
-    def __init__(self, fileobj, initial_buffersize = 128 * 1024): ...
+    read_in_size: int
+    read_nanoseconds: int
+    def __init__(self, fileobj, initial_buffersize = 128 * 1024, *,
+                 use_mmap: bool = False, start: Optional[int] = None,
+                 end: Optional[int] = None,
+                 target_batch_size: int = 256 * 1024): ...
     def __iter__(self) -> FastqParser: ...
     def __next__(self) -> FastqRecordArrayView: ...
     def read(self, number_of_records: int) -> FastqRecordArrayView: ...
+    def read_mates(self, __mate_parser: FastqParser
+                   ) -> Tuple[FastqRecordArrayView, FastqRecordArrayView]: ...
 
 class BamParser:
     header: bytes
-    def __init__(self, fileobj, initial_buffersize = 96 * 1024): ...
+    read_in_size: int
+    read_nanoseconds: int
+    def __init__(self, fileobj, initial_buffersize = 96 * 1024, *,
+                 target_batch_size: int = 256 * 1024): ...
     def __iter__(self) -> BamParser: ...
     def __next__(self) -> FastqRecordArrayView: ...
 
@@ -75,19 +92,41 @@ class QCMetrics:
     def __init__(self): ...
     def add_read(self, __read: FastqRecordView) -> None: ...
     def add_record_array(self, __record_array: FastqRecordArrayView) -> None: ...
-    def base_count_table(self) -> array.ArrayType: ...
-    def phred_count_table(self) -> array.ArrayType: ...
+    def base_count_table(
+        self, ranges: Optional[Iterable[Tuple[int, int]]] = None
+    ) -> array.ArrayType: ...
+    def phred_count_table(
+        self, ranges: Optional[Iterable[Tuple[int, int]]] = None
+    ) -> array.ArrayType: ...
+    def sequence_lengths(self) -> array.ArrayType: ...
     def gc_content(self) -> array.ArrayType: ...
     def phred_scores(self) -> array.ArrayType: ...
+    def merge(self, __other: QCMetrics) -> None: ...
+    def dump(self) -> bytes: ...
+    @classmethod
+    def load(cls, __state: bytes) -> QCMetrics: ...
 
 class AdapterCounter:
     number_of_sequences: int
+    sampled_sequences: int
+    sample_every: int
+    bases_from_start: int
+    bases_from_end: int
     max_length: int
     adapters: Tuple[str, ...]
-    def __init__(self, __adapters: Iterable[str]): ...
+    def __init__(self,
+                 __adapters: Iterable[str],
+                 *,
+                 bases_from_start: int = -1,
+                 bases_from_end: int = -1,
+                 sample_every: int = 1): ...
     def add_read(self, __read: FastqRecordView) -> None: ...
     def add_record_array(self, __record_array: FastqRecordArrayView) -> None: ...
     def get_counts(self) -> List[Tuple[str, array.ArrayType]]: ...
+    def merge(self, __other: AdapterCounter) -> None: ...
+    def dump(self) -> bytes: ...
+    @classmethod
+    def load(cls, __state: bytes) -> AdapterCounter: ...
 
 class PerTileQuality:
     max_length: int 
@@ -96,7 +135,13 @@ class PerTileQuality:
     def __init__(self): ...
     def add_read(self, __read: FastqRecordView) -> None: ...
     def add_record_array(self, __record_array: FastqRecordArrayView) -> None: ...
-    def get_tile_counts(self) -> List[Tuple[int, List[float], List[int]]]: ...
+    def get_tile_counts(
+        self, ranges: Optional[Iterable[Tuple[int, int]]] = None
+    ) -> List[Tuple[int, List[float], List[int]]]: ...
+    def merge(self, __other: PerTileQuality) -> None: ...
+    def dump(self) -> bytes: ...
+    @classmethod
+    def load(cls, __state: bytes) -> PerTileQuality: ...
 
 class OverrepresentedSequences:
     number_of_sequences: int
@@ -106,6 +151,8 @@ class OverrepresentedSequences:
     fragment_length: int
     sample_every: int
     total_fragments: int
+    sketch_memory: int
+    max_heavy_hitters: int
 
     def __init__(self,
                  max_unique_fragments: int = DEFAULT_MAX_UNIQUE_FRAGMENTS,
@@ -113,15 +160,22 @@ class OverrepresentedSequences:
                  sample_every: int = DEFAULT_UNIQUE_SAMPLE_EVERY,
                  bases_from_start: int = DEFAULT_BASES_FROM_START,
                  bases_from_end = DEFAULT_BASES_FROM_END,
+                 *,
+                 sketch_memory: int = 0,
     ): ...
     def add_read(self, __read: FastqRecordView) -> None: ...
     def add_record_array(self, __record_array: FastqRecordArrayView) -> None: ...
     def sequence_counts(self) -> Dict[str, int]: ...
+    def hash_table_stats(self) -> Dict[str, float]: ...
     def overrepresented_sequences(self, 
                                   threshold_fraction: float = 0.0001,
                                   min_threshold: int = 1,
                                   max_threshold: int = sys.maxsize,
                                   ) -> List[Tuple[int, float, str]]: ...
+    def merge(self, __other: OverrepresentedSequences) -> None: ...
+    def dump(self) -> bytes: ...
+    @classmethod
+    def load(cls, __state: bytes) -> OverrepresentedSequences: ...
 
 class DedupEstimator:
     _modulo_bits: int 
@@ -149,6 +203,11 @@ class DedupEstimator:
                               __record_array2: FastqRecordArrayView,
                               ) -> None: ...
     def duplication_counts(self) -> array.ArrayType: ...
+    def hash_table_stats(self) -> Dict[str, float]: ...
+    def merge(self, __other: DedupEstimator) -> None: ...
+    def dump(self) -> bytes: ...
+    @classmethod
+    def load(cls, __state: bytes) -> DedupEstimator: ...
 
 class NanoporeReadInfo:
     start_time: int
@@ -160,12 +219,25 @@ class NanoporeReadInfo:
 
 class NanoStats:
     number_of_reads: int
+    reads_with_parent: int
+    number_of_sampled_reads: int
+    max_sampled_reads: int
+    minutes_per_time_bin: int
     skipped_reason: Optional[str]
     minimum_time: int
     maximum_time: int
+    def __init__(self, *, max_sampled_reads: int = 100_000): ...
     def add_read(self, __read: FastqRecordView) -> None: ...
     def add_record_array(self, __record_array: FastqRecordArrayView) -> None: ...
     def nano_info_iterator(self) -> Iterator[NanoporeReadInfo]: ...
+    def merge(self, __other: NanoStats) -> None: ...
+    def dump(self) -> bytes: ...
+    @classmethod
+    def load(cls, __state: bytes) -> NanoStats: ...
+    def time_slot_statistics(self, __seconds_per_slot: int
+                             ) -> List[Tuple[int, int, int, Tuple[int, ...]]]: ...
+    def channel_statistics(self) -> List[Tuple[int, int, float]]: ...
+    def translocation_speeds(self) -> List[int]: ...
 
 
 class InsertSizeMetrics:
@@ -182,3 +254,22 @@ class InsertSizeMetrics:
     def insert_sizes(self) -> array.ArrayType: ...
     def adapters_read1(self) -> List[Tuple[str, int]]: ...
     def adapters_read2(self) -> List[Tuple[str, int]]: ...
+    def merge(self, __other: InsertSizeMetrics) -> None: ...
+    def dump(self) -> bytes: ...
+    @classmethod
+    def load(cls, __state: bytes) -> InsertSizeMetrics: ...
+
+class QCPipeline:
+    modules: Tuple[object, ...]
+    threads: int
+    split_modules: bool
+
+    def __init__(self, modules: Iterable[object], threads: int = 1,
+                 *, split_modules: bool = False,
+                 profile: bool = False): ...
+    def add_record_array(self, __record_array: FastqRecordArrayView) -> None: ...
+    def finish(self) -> None: ...
+    def module_times(self) -> List[float]: ...
+    def sync(self, modules: Optional[Iterable[object]] = None) -> None: ...
+
+def simd_variants() -> Dict[str, str]: ...
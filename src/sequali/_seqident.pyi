@@ -1,3 +1,25 @@
+from typing import Iterable, List, Tuple
+
+SEQUENCE_INDEX_FILE_VERSION: int
+
+
 def sequence_identity(target: str, query: str,
                       match_score=1, mismatch_penalty=-1, deletion_penalty=-1,
-                      insertion_penalty=-1) -> float: ...
\ No newline at end of file
+                      insertion_penalty=-1) -> float: ...
+
+
+class SequenceIndex:
+    k: int
+    number_of_sequences: int
+    number_of_kmers: int
+
+    def __init__(self, names_and_sequences: Iterable[Tuple[str, str]],
+                 k: int = 13): ...
+    def identify(self, sequence: str, /, match_reverse_complement: bool = True
+                 ) -> Tuple[int, int, str]: ...
+    def identify_batch(self, sequences: Iterable[str], /,
+                       match_reverse_complement: bool = True,
+                       threads: int = 1) -> List[Tuple[int, int, str]]: ...
+    def save(self, path: str, /) -> None: ...
+    @classmethod
+    def load(cls, path: str, /) -> "SequenceIndex": ...
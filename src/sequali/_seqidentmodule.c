@@ -19,11 +19,23 @@ along with Sequali.  If not, see <https://www.gnu.org/licenses/
 #define Py_LIMITED_API 0x030A0000
 #define PY_SSIZE_T_CLEAN
 #include "Python.h"
+#include "structmember.h"
 
 #include "compiler_defs.h"
+#include "simd_dispatch.h"
 
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 struct Entry {
     Py_ssize_t score;
     Py_ssize_t query_matches;
@@ -103,6 +115,28 @@ static int8_t (*get_smith_waterman_matches)(
     int8_t mismatch_penalty, int8_t deletion_penalty,
     int8_t insertion_penalty) = get_smith_waterman_matches_default;
 
+/* The vectorized implementation loads the target over the vector length - 1
+   bytes on both sides. */
+#define SMITH_WATERMAN_PADDING 31
+
+static int8_t
+get_smith_waterman_matches_padded_default(
+    const uint8_t *restrict padded_target, size_t target_length,
+    const uint8_t *restrict query, size_t query_length, int8_t match_score,
+    int8_t mismatch_penalty, int8_t deletion_penalty, int8_t insertion_penalty)
+{
+    return get_smith_waterman_matches_default(
+        padded_target + SMITH_WATERMAN_PADDING, target_length, query,
+        query_length, match_score, mismatch_penalty, deletion_penalty,
+        insertion_penalty);
+}
+
+static int8_t (*get_smith_waterman_matches_padded)(
+    const uint8_t *restrict padded_target, size_t target_length,
+    const uint8_t *restrict query, size_t query_length, int8_t match_score,
+    int8_t mismatch_penalty, int8_t deletion_penalty,
+    int8_t insertion_penalty) = get_smith_waterman_matches_padded_default;
+
 #if COMPILER_HAS_TARGETED_DISPATCH && BUILD_IS_X86_64
 
 /**
@@ -128,24 +162,18 @@ __attribute__((__target__("avx2")))
 /**
  * Get the smith waterman matches by an avx2 algorithm. This goes over
  * diagonals rather than columns, as the diagonals are independent.
+ * padded_target must have SMITH_WATERMAN_PADDING zero bytes before and after
+ * the target. Does not allocate, so it can be used without the GIL.
  */
 static int8_t
-get_smith_waterman_matches_avx2(const uint8_t *restrict target,
-                                size_t target_length,
-                                const uint8_t *restrict query,
-                                size_t query_length, int8_t match_score,
-                                int8_t mismatch_penalty, int8_t deletion_penalty,
-                                int8_t insertion_penalty)
+get_smith_waterman_matches_padded_avx2(const uint8_t *restrict padded_target,
+                                       size_t target_length,
+                                       const uint8_t *restrict query,
+                                       size_t query_length, int8_t match_score,
+                                       int8_t mismatch_penalty,
+                                       int8_t deletion_penalty,
+                                       int8_t insertion_penalty)
 {
-    /* Since the algorithm goes over reversed diagonals, it needs to be padded
-       with  the vector length - 1 on both sides. So vectors can be loaded
-       immediately rather than have a complex initialization. */
-    uint8_t *padded_target = PyMem_Calloc(target_length + 62, 1);
-    if (padded_target == NULL) {
-        return -1;
-    }
-    memcpy(padded_target + 31, target, target_length);
-
     /* Also the query needs to be fitted inside a vector.*/
     uint8_t padded_query_store[32];
     uint8_t *padded_query = padded_query_store;
@@ -262,6 +290,29 @@ get_smith_waterman_matches_avx2(const uint8_t *restrict target,
             best_matches = matches;
         }
     }
+    return best_matches;
+}
+
+__attribute__((__target__("avx2"))) static int8_t
+get_smith_waterman_matches_avx2(const uint8_t *restrict target,
+                                size_t target_length,
+                                const uint8_t *restrict query,
+                                size_t query_length, int8_t match_score,
+                                int8_t mismatch_penalty, int8_t deletion_penalty,
+                                int8_t insertion_penalty)
+{
+    /* Since the algorithm goes over reversed diagonals, it needs to be padded
+       with  the vector length - 1 on both sides. So vectors can be loaded
+       immediately rather than have a complex initialization. */
+    uint8_t *padded_target =
+        PyMem_Calloc(target_length + 2 * SMITH_WATERMAN_PADDING, 1);
+    if (padded_target == NULL) {
+        return -1;
+    }
+    memcpy(padded_target + SMITH_WATERMAN_PADDING, target, target_length);
+    int8_t best_matches = get_smith_waterman_matches_padded_avx2(
+        padded_target, target_length, query, query_length, match_score,
+        mismatch_penalty, deletion_penalty, insertion_penalty);
     PyMem_Free(padded_target);
     return best_matches;
 }
@@ -269,11 +320,15 @@ get_smith_waterman_matches_avx2(const uint8_t *restrict target,
 __attribute__((constructor)) static void
 get_smith_waterman_matches_dispatch(void)
 {
-    if (__builtin_cpu_supports("avx2")) {
+    if (cpu_supports_avx2()) {
         get_smith_waterman_matches = get_smith_waterman_matches_avx2;
+        get_smith_waterman_matches_padded =
+            get_smith_waterman_matches_padded_avx2;
     }
     else {
         get_smith_waterman_matches = get_smith_waterman_matches_default;
+        get_smith_waterman_matches_padded =
+            get_smith_waterman_matches_padded_default;
     }
 }
 #endif
@@ -344,13 +399,1284 @@ sequence_identity(PyObject *module, PyObject *args, PyObject *kwargs)
     return PyFloat_FromDouble(identity);
 }
 
+/******************
+ * SEQUENCE INDEX *
+ ******************/
+
+/* K-mers are stored with 3 bits per nucleotide. The codes sort in the same
+   order as the uppercase characters (A, C, G, N, T), so comparing packed
+   k-mers gives the same result as comparing k-mer strings. Everything that is
+   not ACGT is treated as N, so k-mers with N are indexed as well. */
+#define KMER_BITS_PER_NUCLEOTIDE 3
+#define SEQUENCE_INDEX_MAX_K 21
+#define SEQUENCE_INDEX_MAX_QUERY_LENGTH 31
+
+// clang-format off
+static const uint8_t NUCLEOTIDE_TO_KMER_CODE[256] = {
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 0, 3, 1, 3, 3, 3, 2, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 4, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 0, 3, 1, 3, 3, 3, 2, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 4, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+};
+// clang-format on
+
+static const uint8_t KMER_CODE_COMPLEMENT[5] = {4, 2, 1, 3, 0};
+static const uint8_t KMER_CODE_TO_NUCLEOTIDE[5] = {'A', 'C', 'G', 'N', 'T'};
+
+/**
+ * @brief Write the canonical k-mer for every position of the sequence to
+ *        kmers. The canonical k-mer is the lowest of the k-mer and its
+ *        reverse complement.
+ *
+ * @return size_t the number of k-mers written.
+ */
+static size_t
+sequence_to_canonical_kmers(const uint8_t *sequence, size_t sequence_length,
+                            size_t k, uint64_t *kmers)
+{
+    if (sequence_length < k) {
+        return 0;
+    }
+    uint64_t mask = (1ULL << (k * KMER_BITS_PER_NUCLEOTIDE)) - 1;
+    size_t reverse_shift = (k - 1) * KMER_BITS_PER_NUCLEOTIDE;
+    uint64_t kmer = 0;
+    uint64_t reverse_kmer = 0;
+    size_t number_of_kmers = 0;
+    for (size_t i = 0; i < sequence_length; i++) {
+        uint64_t code = NUCLEOTIDE_TO_KMER_CODE[sequence[i]];
+        kmer = ((kmer << KMER_BITS_PER_NUCLEOTIDE) | code) & mask;
+        reverse_kmer = (reverse_kmer >> KMER_BITS_PER_NUCLEOTIDE) |
+                       ((uint64_t)KMER_CODE_COMPLEMENT[code] << reverse_shift);
+        if (i + 1 >= k) {
+            kmers[number_of_kmers] = kmer < reverse_kmer ? kmer : reverse_kmer;
+            number_of_kmers += 1;
+        }
+    }
+    return number_of_kmers;
+}
+
+static int
+uint64_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Sort the k-mers and remove duplicates.
+ *
+ * @return size_t the number of unique k-mers.
+ */
+static size_t
+unique_kmers(uint64_t *kmers, size_t number_of_kmers)
+{
+    if (number_of_kmers == 0) {
+        return 0;
+    }
+    qsort(kmers, number_of_kmers, sizeof(uint64_t), uint64_compare);
+    size_t unique = 1;
+    for (size_t i = 1; i < number_of_kmers; i++) {
+        if (kmers[i] != kmers[unique - 1]) {
+            kmers[unique] = kmers[i];
+            unique += 1;
+        }
+    }
+    return unique;
+}
+
+struct KmerEntry {
+    uint64_t kmer;
+    size_t sequence_id;
+};
+
+static int
+kmer_entry_compare(const void *a, const void *b)
+{
+    const struct KmerEntry *x = a;
+    const struct KmerEntry *y = b;
+    if (x->kmer != y->kmer) {
+        return (x->kmer > y->kmer) - (x->kmer < y->kmer);
+    }
+    return (x->sequence_id > y->sequence_id) - (x->sequence_id < y->sequence_id);
+}
+
+struct NameKey {
+    const char *name;
+    Py_ssize_t length;
+    size_t sequence_id;
+};
+
+static int
+name_key_compare(const void *a, const void *b)
+{
+    const struct NameKey *x = a;
+    const struct NameKey *y = b;
+    /* UTF-8 byte order is the same as code point order, so this compares
+       like Python string comparison. */
+    int ret = memcmp(x->name, y->name, Py_MIN(x->length, y->length));
+    if (ret != 0) {
+        return ret;
+    }
+    return (x->length > y->length) - (x->length < y->length);
+}
+
+typedef struct _SequenceIndexStruct {
+    PyObject_HEAD
+    Py_ssize_t k;
+    Py_ssize_t number_of_sequences;
+    PyObject *names;
+    /* Not NULL when the arrays below point into a mapped index file. */
+    void *map_start;
+    size_t map_size;
+    /* All targets, each surrounded by SMITH_WATERMAN_PADDING zero bytes. */
+    uint8_t *padded_targets;
+    uint64_t targets_size;
+    uint64_t *target_offsets;
+    uint64_t *target_lengths;
+    /* The position of each name when all names are sorted. */
+    uint32_t *name_ranks;
+    /* Sorted by k-mer, then by sequence id. */
+    Py_ssize_t number_of_kmers;
+    uint64_t *kmers;
+    uint32_t *kmer_sequence_ids;
+} SequenceIndex;
+
+static void
+SequenceIndex_dealloc(SequenceIndex *self)
+{
+    Py_XDECREF(self->names);
+    if (self->map_start != NULL) {
+#ifndef _WIN32
+        munmap(self->map_start, self->map_size);
+#endif
+    }
+    else {
+        PyMem_Free(self->padded_targets);
+        PyMem_Free(self->target_offsets);
+        PyMem_Free(self->target_lengths);
+        PyMem_Free(self->name_ranks);
+        PyMem_Free(self->kmers);
+        PyMem_Free(self->kmer_sequence_ids);
+    }
+    PyTypeObject *tp = Py_TYPE((PyObject *)self);
+    PyObject_Free(self);
+    Py_XDECREF((PyObject *)tp);
+}
+
+static const uint8_t *
+ascii_string_as_bytes(PyObject *string, Py_ssize_t *length)
+{
+    Py_ssize_t string_length = PyUnicode_GetLength(string);
+    const uint8_t *bytes =
+        (const uint8_t *)PyUnicode_AsUTF8AndSize(string, length);
+    if (bytes == NULL) {
+        return NULL;
+    }
+    if (string_length != *length) {
+        PyErr_Format(PyExc_ValueError, "Only ascii strings are allowed. Got %R",
+                     string);
+        return NULL;
+    }
+    return bytes;
+}
+
+/**
+ * @brief Add all sequences to the index. Collects the canonical k-mers of
+ *        each sequence in entries, which is grown as needed.
+ */
+static int
+SequenceIndex_add_sequences(SequenceIndex *self, PyObject *iterator,
+                            struct KmerEntry **entries_ptr,
+                            size_t *number_of_entries_ptr)
+{
+    size_t entries_size = 0;
+    size_t number_of_entries = 0;
+    struct KmerEntry *entries = NULL;
+    size_t targets_size = SMITH_WATERMAN_PADDING;
+    size_t targets_used = SMITH_WATERMAN_PADDING;
+    size_t sequences_size = 0;
+    uint64_t *kmer_buffer = NULL;
+    size_t kmer_buffer_size = 0;
+    int ret = -1;
+    self->padded_targets = PyMem_Calloc(targets_size, 1);
+    if (self->padded_targets == NULL) {
+        PyErr_NoMemory();
+        goto finish;
+    }
+    self->targets_size = targets_used;
+    while (true) {
+        PyObject *item = PyIter_Next(iterator);
+        if (item == NULL) {
+            if (PyErr_Occurred()) {
+                goto finish;
+            }
+            break;
+        }
+        PyObject *name = NULL;
+        PyObject *sequence_obj = NULL;
+        if (!PyArg_ParseTuple(item, "UU:SequenceIndex", &name,
+                              &sequence_obj) ||
+            PyList_Append(self->names, name) != 0) {
+            Py_DECREF(item);
+            goto finish;
+        }
+        Py_ssize_t sequence_length = 0;
+        const uint8_t *sequence =
+            ascii_string_as_bytes(sequence_obj, &sequence_length);
+        if (sequence == NULL) {
+            Py_DECREF(item);
+            goto finish;
+        }
+        size_t sequence_id = self->number_of_sequences;
+        if (sequence_id == UINT32_MAX) {
+            Py_DECREF(item);
+            PyErr_Format(PyExc_ValueError,
+                         "A SequenceIndex can store at most %zd sequences.",
+                         (Py_ssize_t)UINT32_MAX);
+            goto finish;
+        }
+        if (sequence_id == sequences_size) {
+            sequences_size = Py_MAX(sequences_size * 2, 1024);
+            uint64_t *offsets = PyMem_Realloc(
+                self->target_offsets, sequences_size * sizeof(uint64_t));
+            if (offsets != NULL) {
+                self->target_offsets = offsets;
+            }
+            uint64_t *lengths = PyMem_Realloc(
+                self->target_lengths, sequences_size * sizeof(uint64_t));
+            if (lengths != NULL) {
+                self->target_lengths = lengths;
+            }
+            if (offsets == NULL || lengths == NULL) {
+                Py_DECREF(item);
+                PyErr_NoMemory();
+                goto finish;
+            }
+        }
+        size_t needed = targets_used + sequence_length + SMITH_WATERMAN_PADDING;
+        if (needed > targets_size) {
+            size_t new_size = Py_MAX(needed, targets_size * 2);
+            uint8_t *tmp = PyMem_Realloc(self->padded_targets, new_size);
+            if (tmp == NULL) {
+                Py_DECREF(item);
+                PyErr_NoMemory();
+                goto finish;
+            }
+            memset(tmp + targets_size, 0, new_size - targets_size);
+            self->padded_targets = tmp;
+            targets_size = new_size;
+        }
+        memcpy(self->padded_targets + targets_used, sequence, sequence_length);
+        self->target_offsets[sequence_id] =
+            targets_used - SMITH_WATERMAN_PADDING;
+        self->target_lengths[sequence_id] = sequence_length;
+        targets_used = needed;
+        self->targets_size = targets_used;
+
+        if ((size_t)sequence_length > kmer_buffer_size) {
+            PyMem_Free(kmer_buffer);
+            kmer_buffer_size = sequence_length;
+            kmer_buffer = PyMem_Malloc(kmer_buffer_size * sizeof(uint64_t));
+            if (kmer_buffer == NULL) {
+                Py_DECREF(item);
+                PyErr_NoMemory();
+                goto finish;
+            }
+        }
+        size_t number_of_kmers = sequence_to_canonical_kmers(
+            sequence, sequence_length, self->k, kmer_buffer);
+        number_of_kmers = unique_kmers(kmer_buffer, number_of_kmers);
+        Py_DECREF(item);
+        if (number_of_entries + number_of_kmers > entries_size) {
+            size_t new_size = Py_MAX(number_of_entries + number_of_kmers,
+                                     entries_size * 2);
+            struct KmerEntry *tmp =
+                PyMem_Realloc(entries, new_size * sizeof(struct KmerEntry));
+            if (tmp == NULL) {
+                PyErr_NoMemory();
+                goto finish;
+            }
+            entries = tmp;
+            entries_size = new_size;
+        }
+        for (size_t i = 0; i < number_of_kmers; i++) {
+            entries[number_of_entries].kmer = kmer_buffer[i];
+            entries[number_of_entries].sequence_id = sequence_id;
+            number_of_entries += 1;
+        }
+        self->number_of_sequences += 1;
+    }
+    ret = 0;
+finish:
+    PyMem_Free(kmer_buffer);
+    *entries_ptr = entries;
+    *number_of_entries_ptr = number_of_entries;
+    return ret;
+}
+
+static int
+SequenceIndex_rank_names(SequenceIndex *self)
+{
+    size_t number_of_sequences = self->number_of_sequences;
+    struct NameKey *keys =
+        PyMem_Malloc(Py_MAX(number_of_sequences, 1) * sizeof(struct NameKey));
+    self->name_ranks =
+        PyMem_Malloc(Py_MAX(number_of_sequences, 1) * sizeof(uint32_t));
+    if (keys == NULL || self->name_ranks == NULL) {
+        PyMem_Free(keys);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (size_t i = 0; i < number_of_sequences; i++) {
+        PyObject *name = PyList_GetItem(self->names, i);
+        keys[i].name = PyUnicode_AsUTF8AndSize(name, &keys[i].length);
+        if (keys[i].name == NULL) {
+            PyMem_Free(keys);
+            return -1;
+        }
+        keys[i].sequence_id = i;
+    }
+    qsort(keys, number_of_sequences, sizeof(struct NameKey), name_key_compare);
+    for (size_t i = 0; i < number_of_sequences; i++) {
+        self->name_ranks[keys[i].sequence_id] = i;
+    }
+    PyMem_Free(keys);
+    return 0;
+}
+
+static PyObject *
+SequenceIndex__new__(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    static char *format = "O|n:SequenceIndex";
+    static char *kwnames[] = {"names_and_sequences", "k", NULL};
+    PyObject *names_and_sequences = NULL;
+    Py_ssize_t k = 13;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, format, kwnames,
+                                     &names_and_sequences, &k)) {
+        return NULL;
+    }
+    if (k % 2 == 0) {
+        PyErr_Format(PyExc_ValueError, "K must be uneven, got %zd", k);
+        return NULL;
+    }
+    if (k < 1 || k > SEQUENCE_INDEX_MAX_K) {
+        PyErr_Format(PyExc_ValueError, "K must be between 1 and %d, got %zd",
+                     SEQUENCE_INDEX_MAX_K, k);
+        return NULL;
+    }
+    PyObject *iterator = PyObject_GetIter(names_and_sequences);
+    if (iterator == NULL) {
+        return NULL;
+    }
+    SequenceIndex *self = PyObject_New(SequenceIndex, type);
+    if (self == NULL) {
+        Py_DECREF(iterator);
+        return PyErr_NoMemory();
+    }
+    self->k = k;
+    self->number_of_sequences = 0;
+    self->padded_targets = NULL;
+    self->map_start = NULL;
+    self->map_size = 0;
+    self->targets_size = 0;
+    self->target_offsets = NULL;
+    self->target_lengths = NULL;
+    self->name_ranks = NULL;
+    self->number_of_kmers = 0;
+    self->kmers = NULL;
+    self->kmer_sequence_ids = NULL;
+    self->names = PyList_New(0);
+    if (self->names == NULL) {
+        Py_DECREF(iterator);
+        Py_DECREF(self);
+        return NULL;
+    }
+    struct KmerEntry *entries = NULL;
+    size_t number_of_entries = 0;
+    int ret = SequenceIndex_add_sequences(self, iterator, &entries,
+                                          &number_of_entries);
+    Py_DECREF(iterator);
+    if (ret != 0 || SequenceIndex_rank_names(self) != 0) {
+        PyMem_Free(entries);
+        Py_DECREF(self);
+        return NULL;
+    }
+    qsort(entries, number_of_entries, sizeof(struct KmerEntry),
+          kmer_entry_compare);
+    self->kmers = PyMem_Malloc(Py_MAX(number_of_entries, 1) * sizeof(uint64_t));
+    self->kmer_sequence_ids =
+        PyMem_Malloc(Py_MAX(number_of_entries, 1) * sizeof(uint32_t));
+    if (self->kmers == NULL || self->kmer_sequence_ids == NULL) {
+        PyMem_Free(entries);
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    for (size_t i = 0; i < number_of_entries; i++) {
+        self->kmers[i] = entries[i].kmer;
+        self->kmer_sequence_ids[i] = entries[i].sequence_id;
+    }
+    self->number_of_kmers = number_of_entries;
+    PyMem_Free(entries);
+    return (PyObject *)self;
+}
+
+struct IdentifyCandidate {
+    size_t count;
+    size_t length;
+    size_t name_rank;
+    size_t sequence_id;
+};
+
+static int
+identify_candidate_compare(const void *a, const void *b)
+{
+    const struct IdentifyCandidate *x = a;
+    const struct IdentifyCandidate *y = b;
+    /* Highest counts first, then the shortest sequences and then the
+       highest names. This is the order of the earlier Python implementation
+       which sorted on (count, -length, name) in reverse. */
+    if (x->count != y->count) {
+        return (x->count < y->count) - (x->count > y->count);
+    }
+    if (x->length != y->length) {
+        return (x->length > y->length) - (x->length < y->length);
+    }
+    return (x->name_rank < y->name_rank) - (x->name_rank > y->name_rank);
+}
+
+struct IdentifyResult {
+    size_t matches;
+    Py_ssize_t sequence_id;
+    bool query_too_long;
+};
+
+/* Buffers for identifying a query sequence. Each thread has its own. */
+struct IdentifyWorker {
+    SequenceIndex *index;
+    const uint8_t **queries;
+    size_t *query_lengths;
+    struct IdentifyResult *results;
+    size_t number_of_queries;
+    size_t first_query;
+    size_t query_step;
+    bool match_reverse_complement;
+    uint64_t *kmers;
+    uint8_t *reverse_complement;
+    uint32_t *counts;
+    struct IdentifyCandidate *candidates;
+    PyThread_type_lock done;
+};
+
+static void
+SequenceIndex_identify_query(SequenceIndex *self, struct IdentifyWorker *worker,
+                             const uint8_t *query, size_t query_length,
+                             struct IdentifyResult *result)
+{
+    result->matches = 0;
+    result->sequence_id = -1;
+    result->query_too_long = false;
+    size_t number_of_kmers =
+        sequence_to_canonical_kmers(query, query_length, self->k, worker->kmers);
+    number_of_kmers = unique_kmers(worker->kmers, number_of_kmers);
+    uint32_t *counts = worker->counts;
+    struct IdentifyCandidate *candidates = worker->candidates;
+    size_t number_of_candidates = 0;
+    const uint64_t *index_kmers = self->kmers;
+    for (size_t i = 0; i < number_of_kmers; i++) {
+        uint64_t kmer = worker->kmers[i];
+        /* Binary search for the first entry of the k-mer. */
+        size_t low = 0;
+        size_t high = self->number_of_kmers;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (index_kmers[middle] < kmer) {
+                low = middle + 1;
+            }
+            else {
+                high = middle;
+            }
+        }
+        for (size_t j = low;
+             j < (size_t)self->number_of_kmers && index_kmers[j] == kmer; j++) {
+            size_t sequence_id = self->kmer_sequence_ids[j];
+            if (counts[sequence_id] == 0) {
+                candidates[number_of_candidates].sequence_id = sequence_id;
+                number_of_candidates += 1;
+            }
+            counts[sequence_id] += 1;
+        }
+    }
+    for (size_t i = 0; i < number_of_candidates; i++) {
+        struct IdentifyCandidate *candidate = candidates + i;
+        size_t sequence_id = candidate->sequence_id;
+        candidate->count = counts[sequence_id];
+        candidate->length = self->target_lengths[sequence_id];
+        candidate->name_rank = self->name_ranks[sequence_id];
+        counts[sequence_id] = 0;
+    }
+    if (number_of_candidates == 0) {
+        return;
+    }
+    if (query_length > SEQUENCE_INDEX_MAX_QUERY_LENGTH) {
+        result->query_too_long = true;
+        return;
+    }
+    qsort(candidates, number_of_candidates, sizeof(struct IdentifyCandidate),
+          identify_candidate_compare);
+    uint8_t *reverse_complement = worker->reverse_complement;
+    if (worker->match_reverse_complement) {
+        for (size_t i = 0; i < query_length; i++) {
+            uint8_t code = NUCLEOTIDE_TO_KMER_CODE[query[query_length - 1 - i]];
+            reverse_complement[i] =
+                KMER_CODE_TO_NUCLEOTIDE[KMER_CODE_COMPLEMENT[code]];
+        }
+    }
+    size_t best_matches = 0;
+    for (size_t i = 0; i < number_of_candidates; i++) {
+        size_t sequence_id = candidates[i].sequence_id;
+        const uint8_t *padded_target =
+            self->padded_targets + self->target_offsets[sequence_id];
+        size_t target_length = self->target_lengths[sequence_id];
+        size_t matches = get_smith_waterman_matches_padded(
+            padded_target, target_length, query, query_length, 1, -1, -1, -1);
+        if (worker->match_reverse_complement) {
+            size_t reverse_matches = get_smith_waterman_matches_padded(
+                padded_target, target_length, reverse_complement, query_length,
+                1, -1, -1, -1);
+            matches = Py_MAX(matches, reverse_matches);
+        }
+        if (matches > best_matches) {
+            best_matches = matches;
+            result->matches = matches;
+            result->sequence_id = sequence_id;
+            if (matches == query_length) {
+                break;
+            }
+        }
+    }
+}
+
+static void
+IdentifyWorker_run(struct IdentifyWorker *worker)
+{
+    for (size_t i = worker->first_query; i < worker->number_of_queries;
+         i += worker->query_step) {
+        SequenceIndex_identify_query(worker->index, worker, worker->queries[i],
+                                     worker->query_lengths[i],
+                                     worker->results + i);
+    }
+}
+
+static void
+IdentifyWorker_thread(void *arg)
+{
+    struct IdentifyWorker *worker = arg;
+    IdentifyWorker_run(worker);
+    /* The worker is freed by the calling thread as soon as done is released,
+       so it should not be touched afterwards. */
+    PyThread_release_lock(worker->done);
+}
+
+static void
+IdentifyWorker_free_buffers(struct IdentifyWorker *worker)
+{
+    PyMem_Free(worker->kmers);
+    PyMem_Free(worker->reverse_complement);
+    PyMem_Free(worker->counts);
+    PyMem_Free(worker->candidates);
+    if (worker->done != NULL) {
+        PyThread_free_lock(worker->done);
+    }
+}
+
+/**
+ * @brief Identify all queries with the GIL released, using up to threads
+ *        threads.
+ *
+ * @return int 0 on success, -1 with an exception set on error.
+ */
+static int
+SequenceIndex_identify_all(SequenceIndex *self, const uint8_t **queries,
+                           size_t *query_lengths, size_t number_of_queries,
+                           bool match_reverse_complement, size_t threads,
+                           struct IdentifyResult *results)
+{
+    size_t max_query_length = 1;
+    for (size_t i = 0; i < number_of_queries; i++) {
+        max_query_length = Py_MAX(max_query_length, query_lengths[i]);
+    }
+    threads = Py_MIN(threads, Py_MAX(number_of_queries, 1));
+    struct IdentifyWorker *workers =
+        PyMem_Calloc(threads, sizeof(struct IdentifyWorker));
+    if (workers == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    int ret = -1;
+    size_t started_threads = 0;
+    size_t number_of_sequences = Py_MAX(self->number_of_sequences, 1);
+    for (size_t i = 0; i < threads; i++) {
+        struct IdentifyWorker *worker = workers + i;
+        worker->index = self;
+        worker->queries = queries;
+        worker->query_lengths = query_lengths;
+        worker->results = results;
+        worker->number_of_queries = number_of_queries;
+        worker->first_query = i;
+        worker->query_step = threads;
+        worker->match_reverse_complement = match_reverse_complement;
+        worker->kmers = PyMem_Malloc(max_query_length * sizeof(uint64_t));
+        worker->reverse_complement = PyMem_Malloc(max_query_length);
+        worker->counts = PyMem_Calloc(number_of_sequences, sizeof(uint32_t));
+        worker->candidates = PyMem_Malloc(number_of_sequences *
+                                          sizeof(struct IdentifyCandidate));
+        if (worker->kmers == NULL || worker->reverse_complement == NULL ||
+            worker->counts == NULL || worker->candidates == NULL) {
+            PyErr_NoMemory();
+            goto finish;
+        }
+    }
+    /* The calling thread does the work of the first worker. */
+    bool start_error = false;
+    for (size_t i = 1; i < threads; i++) {
+        struct IdentifyWorker *worker = workers + i;
+        worker->done = PyThread_allocate_lock();
+        if (worker->done == NULL) {
+            PyErr_NoMemory();
+            start_error = true;
+            break;
+        }
+        PyThread_acquire_lock(worker->done, WAIT_LOCK);
+        /* PYTHREAD_INVALID_THREAD_ID is not part of the limited API. */
+        if (PyThread_start_new_thread(IdentifyWorker_thread, worker) ==
+            (unsigned long)-1) {
+            PyThread_release_lock(worker->done);
+            PyErr_SetString(PyExc_RuntimeError, "can't start new thread");
+            start_error = true;
+            break;
+        }
+        started_threads += 1;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    if (!start_error) {
+        IdentifyWorker_run(workers);
+    }
+    for (size_t i = 1; i < started_threads + 1; i++) {
+        PyThread_acquire_lock(workers[i].done, WAIT_LOCK);
+        PyThread_release_lock(workers[i].done);
+    }
+    Py_END_ALLOW_THREADS
+    if (!start_error) {
+        ret = 0;
+    }
+finish:
+    for (size_t i = 0; i < threads; i++) {
+        IdentifyWorker_free_buffers(workers + i);
+    }
+    PyMem_Free(workers);
+    return ret;
+}
+
+static PyObject *
+SequenceIndex_result_to_tuple(SequenceIndex *self, struct IdentifyResult *result,
+                              size_t query_length)
+{
+    if (result->query_too_long) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "Only query with lengths less than 32 are supported. Got %zd",
+            (Py_ssize_t)query_length);
+        return NULL;
+    }
+    PyObject *name = NULL;
+    if (result->sequence_id < 0) {
+        name = PyUnicode_FromString("No match");
+    }
+    else {
+        name = PyList_GetItem(self->names, result->sequence_id);
+        Py_XINCREF(name);
+    }
+    if (name == NULL) {
+        return NULL;
+    }
+    PyObject *tup = Py_BuildValue("(nnN)", (Py_ssize_t)result->matches,
+                                  (Py_ssize_t)query_length, name);
+    return tup;
+}
+
+PyDoc_STRVAR(SequenceIndex_identify__doc__,
+             "identify($self, sequence, /, match_reverse_complement=True)\n"
+             "--\n"
+             "\n"
+             "Identify a sequence using the sequences in the index.\n"
+             "\n"
+             "  sequence\n"
+             "    An ASCII string with at most 31 characters.\n"
+             "  match_reverse_complement\n"
+             "    Also match the reverse complement of the sequence.\n"
+             "\n"
+             "Returns a tuple of the number of matches, the maximum number\n"
+             "of matches and the name of the best match or 'No match'.\n");
+
+#define SequenceIndex_identify_method METH_VARARGS | METH_KEYWORDS
+
+static PyObject *
+SequenceIndex_identify(SequenceIndex *self, PyObject *args, PyObject *kwargs)
+{
+    static char *format = "U|p:identify";
+    static char *kwnames[] = {"", "match_reverse_complement", NULL};
+    PyObject *sequence_obj = NULL;
+    int match_reverse_complement = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, format, kwnames,
+                                     &sequence_obj, &match_reverse_complement)) {
+        return NULL;
+    }
+    Py_ssize_t sequence_length = 0;
+    const uint8_t *sequence =
+        ascii_string_as_bytes(sequence_obj, &sequence_length);
+    if (sequence == NULL) {
+        return NULL;
+    }
+    size_t query_length = sequence_length;
+    struct IdentifyResult result;
+    if (SequenceIndex_identify_all(self, &sequence, &query_length, 1,
+                                   match_reverse_complement, 1, &result) != 0) {
+        return NULL;
+    }
+    return SequenceIndex_result_to_tuple(self, &result, query_length);
+}
+
+PyDoc_STRVAR(
+    SequenceIndex_identify_batch__doc__,
+    "identify_batch($self, sequences, /, match_reverse_complement=True, "
+    "threads=1)\n"
+    "--\n"
+    "\n"
+    "Identify multiple sequences using the sequences in the index. The\n"
+    "GIL is released during identification.\n"
+    "\n"
+    "  sequences\n"
+    "    An iterable of ASCII strings with at most 31 characters.\n"
+    "  match_reverse_complement\n"
+    "    Also match the reverse complement of the sequences.\n"
+    "  threads\n"
+    "    The number of threads to use.\n"
+    "\n"
+    "Returns a list of tuples in the same format as identify.\n");
+
+#define SequenceIndex_identify_batch_method METH_VARARGS | METH_KEYWORDS
+
+static PyObject *
+SequenceIndex_identify_batch(SequenceIndex *self, PyObject *args,
+                             PyObject *kwargs)
+{
+    static char *format = "O|pn:identify_batch";
+    static char *kwnames[] = {"", "match_reverse_complement", "threads", NULL};
+    PyObject *sequences_obj = NULL;
+    int match_reverse_complement = 1;
+    Py_ssize_t threads = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, format, kwnames,
+                                     &sequences_obj, &match_reverse_complement,
+                                     &threads)) {
+        return NULL;
+    }
+    if (threads < 1) {
+        PyErr_Format(PyExc_ValueError,
+                     "threads must be at least 1, got %zd", threads);
+        return NULL;
+    }
+    /* Keep a reference to all sequences so their UTF-8 representations stay
+       alive while the GIL is released. */
+    PyObject *sequences = PySequence_Tuple(sequences_obj);
+    if (sequences == NULL) {
+        return NULL;
+    }
+    Py_ssize_t number_of_queries = PyTuple_Size(sequences);
+    const uint8_t **queries =
+        PyMem_Malloc(Py_MAX(number_of_queries, 1) * sizeof(uint8_t *));
+    size_t *query_lengths =
+        PyMem_Malloc(Py_MAX(number_of_queries, 1) * sizeof(size_t));
+    struct IdentifyResult *results = PyMem_Malloc(
+        Py_MAX(number_of_queries, 1) * sizeof(struct IdentifyResult));
+    PyObject *result_list = NULL;
+    if (queries == NULL || query_lengths == NULL || results == NULL) {
+        PyErr_NoMemory();
+        goto finish;
+    }
+    for (Py_ssize_t i = 0; i < number_of_queries; i++) {
+        PyObject *sequence_obj = PyTuple_GetItem(sequences, i);
+        if (!PyUnicode_CheckExact(sequence_obj)) {
+            PyErr_Format(PyExc_TypeError,
+                         "sequences should contain str objects, got %R",
+                         Py_TYPE(sequence_obj));
+            goto finish;
+        }
+        Py_ssize_t sequence_length = 0;
+        queries[i] = ascii_string_as_bytes(sequence_obj, &sequence_length);
+        if (queries[i] == NULL) {
+            goto finish;
+        }
+        query_lengths[i] = sequence_length;
+    }
+    if (SequenceIndex_identify_all(self, queries, query_lengths,
+                                   number_of_queries, match_reverse_complement,
+                                   threads, results) != 0) {
+        goto finish;
+    }
+    result_list = PyList_New(number_of_queries);
+    if (result_list == NULL) {
+        goto finish;
+    }
+    for (Py_ssize_t i = 0; i < number_of_queries; i++) {
+        PyObject *tup = SequenceIndex_result_to_tuple(self, results + i,
+                                                      query_lengths[i]);
+        if (tup == NULL) {
+            Py_CLEAR(result_list);
+            goto finish;
+        }
+        PyList_SetItem(result_list, i, tup);
+    }
+finish:
+    Py_DECREF(sequences);
+    PyMem_Free(queries);
+    PyMem_Free(query_lengths);
+    PyMem_Free(results);
+    return result_list;
+}
+
+/* An index file holds a fixed size header followed by the arrays of the
+   index in native byte order. Each array starts at a multiple of 8 bytes so
+   the arrays can be used directly from a memory mapping. The names are
+   stored as UTF-8 with the offset of each name in a separate array. */
+#define SEQUENCE_INDEX_FILE_MAGIC "SQLIIDX"
+#define SEQUENCE_INDEX_FILE_VERSION 1
+#define SEQUENCE_INDEX_BYTE_ORDER_MARK 0x01020304
+
+struct SequenceIndexFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order_mark;
+    uint64_t k;
+    uint64_t number_of_sequences;
+    uint64_t number_of_kmers;
+    uint64_t targets_size;
+    uint64_t names_size;
+};
+
+struct SequenceIndexFileLayout {
+    size_t kmers;
+    size_t kmer_sequence_ids;
+    size_t target_offsets;
+    size_t target_lengths;
+    size_t name_ranks;
+    size_t name_offsets;
+    size_t names;
+    size_t padded_targets;
+    size_t total;
+};
+
+static inline size_t
+align_to_8(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+static void
+SequenceIndexFileLayout_from_header(
+    struct SequenceIndexFileLayout *layout,
+    const struct SequenceIndexFileHeader *header)
+{
+    size_t number_of_kmers = header->number_of_kmers;
+    size_t number_of_sequences = header->number_of_sequences;
+    layout->kmers = sizeof(struct SequenceIndexFileHeader);
+    layout->kmer_sequence_ids =
+        layout->kmers + number_of_kmers * sizeof(uint64_t);
+    layout->target_offsets = layout->kmer_sequence_ids +
+                             align_to_8(number_of_kmers * sizeof(uint32_t));
+    layout->target_lengths =
+        layout->target_offsets + number_of_sequences * sizeof(uint64_t);
+    layout->name_ranks =
+        layout->target_lengths + number_of_sequences * sizeof(uint64_t);
+    layout->name_offsets = layout->name_ranks +
+                           align_to_8(number_of_sequences * sizeof(uint32_t));
+    layout->names =
+        layout->name_offsets + (number_of_sequences + 1) * sizeof(uint64_t);
+    layout->padded_targets = layout->names + align_to_8(header->names_size);
+    layout->total = layout->padded_targets + header->targets_size;
+}
+
+static int
+write_padded(FILE *file, const void *data, size_t size)
+{
+    static const uint8_t zeroes[8] = {0};
+    if (fwrite(data, 1, size, file) != size) {
+        return -1;
+    }
+    size_t padding = align_to_8(size) - size;
+    if (fwrite(zeroes, 1, padding, file) != padding) {
+        return -1;
+    }
+    return 0;
+}
+
+PyDoc_STRVAR(SequenceIndex_save__doc__,
+             "save($self, path, /)\n"
+             "--\n"
+             "\n"
+             "Save the index to a file that can be loaded with\n"
+             "SequenceIndex.load.\n");
+
+#define SequenceIndex_save_method METH_O
+
+static PyObject *
+SequenceIndex_save(SequenceIndex *self, PyObject *path_obj)
+{
+    PyObject *path_bytes = NULL;
+    if (!PyUnicode_FSConverter(path_obj, &path_bytes)) {
+        return NULL;
+    }
+    size_t number_of_sequences = self->number_of_sequences;
+    uint64_t *name_offsets =
+        PyMem_Malloc((number_of_sequences + 1) * sizeof(uint64_t));
+    const char **names = PyMem_Malloc(Py_MAX(number_of_sequences, 1) *
+                                      sizeof(const char *));
+    PyObject *ret = NULL;
+    FILE *file = NULL;
+    if (name_offsets == NULL || names == NULL) {
+        PyErr_NoMemory();
+        goto finish;
+    }
+    name_offsets[0] = 0;
+    for (size_t i = 0; i < number_of_sequences; i++) {
+        Py_ssize_t name_length = 0;
+        names[i] = PyUnicode_AsUTF8AndSize(PyList_GetItem(self->names, i),
+                                           &name_length);
+        if (names[i] == NULL) {
+            goto finish;
+        }
+        name_offsets[i + 1] = name_offsets[i] + name_length;
+    }
+    struct SequenceIndexFileHeader header = {
+        .magic = SEQUENCE_INDEX_FILE_MAGIC,
+        .version = SEQUENCE_INDEX_FILE_VERSION,
+        .byte_order_mark = SEQUENCE_INDEX_BYTE_ORDER_MARK,
+        .k = self->k,
+        .number_of_sequences = number_of_sequences,
+        .number_of_kmers = self->number_of_kmers,
+        .targets_size = self->targets_size,
+        .names_size = name_offsets[number_of_sequences],
+    };
+    file = fopen(PyBytes_AsString(path_bytes), "wb");
+    if (file == NULL) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path_obj);
+        goto finish;
+    }
+    size_t number_of_kmers = self->number_of_kmers;
+    int write_error =
+        write_padded(file, &header, sizeof(header)) ||
+        write_padded(file, self->kmers, number_of_kmers * sizeof(uint64_t)) ||
+        write_padded(file, self->kmer_sequence_ids,
+                     number_of_kmers * sizeof(uint32_t)) ||
+        write_padded(file, self->target_offsets,
+                     number_of_sequences * sizeof(uint64_t)) ||
+        write_padded(file, self->target_lengths,
+                     number_of_sequences * sizeof(uint64_t)) ||
+        write_padded(file, self->name_ranks,
+                     number_of_sequences * sizeof(uint32_t)) ||
+        write_padded(file, name_offsets,
+                     (number_of_sequences + 1) * sizeof(uint64_t));
+    for (size_t i = 0; i < number_of_sequences && !write_error; i++) {
+        size_t name_length = name_offsets[i + 1] - name_offsets[i];
+        write_error = fwrite(names[i], 1, name_length, file) != name_length;
+    }
+    if (!write_error) {
+        size_t padding = align_to_8(header.names_size) - header.names_size;
+        write_error = fwrite("\0\0\0\0\0\0\0", 1, padding, file) != padding ||
+                      fwrite(self->padded_targets, 1, self->targets_size,
+                             file) != self->targets_size;
+    }
+    if (write_error) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path_obj);
+        goto finish;
+    }
+    if (fclose(file) != 0) {
+        file = NULL;
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path_obj);
+        goto finish;
+    }
+    file = NULL;
+    ret = Py_None;
+    Py_INCREF(ret);
+finish:
+    if (file != NULL) {
+        fclose(file);
+    }
+    Py_DECREF(path_bytes);
+    PyMem_Free(name_offsets);
+    PyMem_Free(names);
+    return ret;
+}
+
+/**
+ * @brief Check that all offsets in a mapped index file stay within the
+ *        mapping.
+ *
+ * @return const char* NULL when the index is valid, otherwise a description
+ *         of the problem.
+ */
+static const char *
+SequenceIndex_validate_mapping(SequenceIndex *self, const uint64_t *name_offsets,
+                               uint64_t names_size)
+{
+    size_t number_of_sequences = self->number_of_sequences;
+    for (Py_ssize_t i = 0; i < self->number_of_kmers; i++) {
+        if (self->kmer_sequence_ids[i] >= number_of_sequences) {
+            return "k-mer sequence id out of range";
+        }
+    }
+    if (name_offsets[0] != 0 || name_offsets[number_of_sequences] != names_size) {
+        return "invalid name offsets";
+    }
+    for (size_t i = 0; i < number_of_sequences; i++) {
+        if (name_offsets[i + 1] < name_offsets[i]) {
+            return "invalid name offsets";
+        }
+        if (self->name_ranks[i] >= number_of_sequences) {
+            return "name rank out of range";
+        }
+        uint64_t offset = self->target_offsets[i];
+        uint64_t length = self->target_lengths[i];
+        if (offset > self->targets_size || length > self->targets_size ||
+            offset + length + 2 * SMITH_WATERMAN_PADDING > self->targets_size) {
+            return "target out of range";
+        }
+    }
+    return NULL;
+}
+
+PyDoc_STRVAR(SequenceIndex_load__doc__,
+             "load($type, path, /)\n"
+             "--\n"
+             "\n"
+             "Load an index that was stored with SequenceIndex.save. The file\n"
+             "is memory mapped read-only, so processes that load the same\n"
+             "file share its memory.\n");
+
+#define SequenceIndex_load_method METH_O | METH_CLASS
+
+static PyObject *
+SequenceIndex_load(PyTypeObject *type, PyObject *path_obj)
+{
+#ifdef _WIN32
+    PyErr_Format(PyExc_OSError,
+                 "Memory mapping files is not supported on this platform.");
+    return NULL;
+#else
+    PyObject *path_bytes = NULL;
+    if (!PyUnicode_FSConverter(path_obj, &path_bytes)) {
+        return NULL;
+    }
+    int fd = open(PyBytes_AsString(path_bytes), O_RDONLY);
+    Py_DECREF(path_bytes);
+    if (fd == -1) {
+        return PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path_obj);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        return PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path_obj);
+    }
+    size_t map_size = file_stat.st_size;
+    if (map_size < sizeof(struct SequenceIndexFileHeader)) {
+        close(fd);
+        PyErr_Format(PyExc_ValueError,
+                     "Invalid sequence index file %R: file too small",
+                     path_obj);
+        return NULL;
+    }
+    void *map_start = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map_start == MAP_FAILED) {
+        return PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path_obj);
+    }
+    SequenceIndex *self = PyObject_New(SequenceIndex, type);
+    if (self == NULL) {
+        munmap(map_start, map_size);
+        return PyErr_NoMemory();
+    }
+    self->map_start = map_start;
+    self->map_size = map_size;
+    self->names = NULL;
+
+    const char *error = NULL;
+    struct SequenceIndexFileHeader header;
+    memcpy(&header, map_start, sizeof(header));
+    if (memcmp(header.magic, SEQUENCE_INDEX_FILE_MAGIC, 8) != 0) {
+        error = "not a sequence index file";
+    }
+    else if (header.version != SEQUENCE_INDEX_FILE_VERSION) {
+        error = "unsupported version";
+    }
+    else if (header.byte_order_mark != SEQUENCE_INDEX_BYTE_ORDER_MARK) {
+        error = "wrong byte order";
+    }
+    else if (header.k % 2 == 0 || header.k > SEQUENCE_INDEX_MAX_K) {
+        error = "invalid k";
+    }
+    /* Bound the counts by the file size first, so the layout calculation
+       can not overflow. */
+    else if (header.number_of_kmers > map_size ||
+             header.number_of_sequences >= UINT32_MAX ||
+             header.number_of_sequences > map_size ||
+             header.targets_size > map_size || header.names_size > map_size ||
+             header.targets_size < SMITH_WATERMAN_PADDING) {
+        error = "invalid sizes";
+    }
+    struct SequenceIndexFileLayout layout;
+    if (error == NULL) {
+        SequenceIndexFileLayout_from_header(&layout, &header);
+        if (layout.total != map_size) {
+            error = "file size does not match the header";
+        }
+    }
+    if (error != NULL) {
+        PyErr_Format(PyExc_ValueError, "Invalid sequence index file %R: %s",
+                     path_obj, error);
+        Py_DECREF(self);
+        return NULL;
+    }
+    uint8_t *data = map_start;
+    self->k = header.k;
+    self->number_of_sequences = header.number_of_sequences;
+    self->number_of_kmers = header.number_of_kmers;
+    self->targets_size = header.targets_size;
+    self->kmers = (uint64_t *)(data + layout.kmers);
+    self->kmer_sequence_ids = (uint32_t *)(data + layout.kmer_sequence_ids);
+    self->target_offsets = (uint64_t *)(data + layout.target_offsets);
+    self->target_lengths = (uint64_t *)(data + layout.target_lengths);
+    self->name_ranks = (uint32_t *)(data + layout.name_ranks);
+    self->padded_targets = data + layout.padded_targets;
+    const uint64_t *name_offsets = (const uint64_t *)(data + layout.name_offsets);
+    error =
+        SequenceIndex_validate_mapping(self, name_offsets, header.names_size);
+    if (error != NULL) {
+        PyErr_Format(PyExc_ValueError, "Invalid sequence index file %R: %s",
+                     path_obj, error);
+        Py_DECREF(self);
+        return NULL;
+    }
+    self->names = PyList_New(self->number_of_sequences);
+    if (self->names == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    const char *names = (const char *)(data + layout.names);
+    for (Py_ssize_t i = 0; i < self->number_of_sequences; i++) {
+        PyObject *name =
+            PyUnicode_DecodeUTF8(names + name_offsets[i],
+                                 name_offsets[i + 1] - name_offsets[i], NULL);
+        if (name == NULL) {
+            Py_DECREF(self);
+            return NULL;
+        }
+        PyList_SetItem(self->names, i, name);
+    }
+    return (PyObject *)self;
+#endif
+}
+
+static PyMethodDef SequenceIndex_methods[] = {
+    {"identify", (PyCFunction)SequenceIndex_identify,
+     SequenceIndex_identify_method, SequenceIndex_identify__doc__},
+    {"identify_batch", (PyCFunction)SequenceIndex_identify_batch,
+     SequenceIndex_identify_batch_method, SequenceIndex_identify_batch__doc__},
+    {"save", (PyCFunction)SequenceIndex_save, SequenceIndex_save_method,
+     SequenceIndex_save__doc__},
+    {"load", (PyCFunction)SequenceIndex_load, SequenceIndex_load_method,
+     SequenceIndex_load__doc__},
+    {NULL},
+};
+
+static PyMemberDef SequenceIndex_members[] = {
+    {"k", T_PYSSIZET, offsetof(SequenceIndex, k), READONLY,
+     "The k-mer size of the index."},
+    {"number_of_sequences", T_PYSSIZET,
+     offsetof(SequenceIndex, number_of_sequences), READONLY,
+     "The number of sequences in the index."},
+    {"number_of_kmers", T_PYSSIZET, offsetof(SequenceIndex, number_of_kmers),
+     READONLY,
+     "The number of stored k-mer entries. A k-mer that occurs in multiple "
+     "sequences has an entry for each sequence."},
+    {NULL},
+};
+
+PyDoc_STRVAR(SequenceIndex__doc__,
+             "SequenceIndex(names_and_sequences, k=13)\n"
+             "--\n"
+             "\n"
+             "An index of canonical k-mers for identifying sequences.\n"
+             "\n"
+             "  names_and_sequences\n"
+             "    An iterable of (name, sequence) tuples.\n"
+             "  k\n"
+             "    The k-mer size. Must be uneven and at most 21.\n");
+
+static PyType_Slot SequenceIndex_slots[] = {
+    {Py_tp_dealloc, (destructor)SequenceIndex_dealloc},
+    {Py_tp_new, SequenceIndex__new__},
+    {Py_tp_members, SequenceIndex_members},
+    {Py_tp_methods, SequenceIndex_methods},
+    {Py_tp_doc, (char *)SequenceIndex__doc__},
+    {0, NULL},
+};
+
+static PyType_Spec SequenceIndex_spec = {
+    .name = "_seqident.SequenceIndex",
+    .basicsize = sizeof(SequenceIndex),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots = SequenceIndex_slots,
+};
+
 static PyMethodDef _seqident_methods[] = {
     {"sequence_identity", (PyCFunction)sequence_identity,
      sequence_identity_method, sequence_identity__doc__},
     {NULL},
 };
 
+static int
+_seqident_exec(PyObject *module)
+{
+    if (simd_check_environment() != 0) {
+        return -1;
+    }
+    PyTypeObject *type = (PyTypeObject *)PyType_FromModuleAndSpec(
+        module, &SequenceIndex_spec, NULL);
+    if (type == NULL) {
+        return -1;
+    }
+    if (PyModule_AddObject(module, "SequenceIndex", (PyObject *)type) != 0) {
+        Py_DECREF(type);
+        return -1;
+    }
+    return PyModule_AddIntMacro(module, SEQUENCE_INDEX_FILE_VERSION);
+}
+
 static PyModuleDef_Slot _seqident_module_slots[] = {
+    {Py_mod_exec, _seqident_exec},
     {0, NULL},
 };
 
@@ -20,16 +20,16 @@ import dataclasses
 import html
 import io
 import math
+import operator
 import os
 import sys
 import time
 import typing
 import xml.etree.ElementTree
 from abc import ABC, abstractmethod
-from collections import defaultdict
 from pathlib import Path
 from typing import (Any, Dict, Iterable, Iterator, List, Optional, Sequence,
-                    Set, Tuple, Type)
+                    Tuple, Type, Union)
 
 import pygal  # type: ignore
 import pygal.style  # type: ignore
@@ -49,6 +49,7 @@ from ._qc import NUMBER_OF_NUCS, NUMBER_OF_PHREDS, PHRED_MAX
 from ._version import __version__
 from .adapters import Adapter
 from .sequence_identification import (identify_sequence_builtin,
+                                      identify_sequences_builtin,
                                       reverse_complement)
 
 SEQUALI_REPORT_CSS = Path(__file__).parent / "static" / "sequali_report.css"
@@ -365,20 +366,32 @@ class Meta(ReportModule):
     filesize: int
     filename_read2: Optional[str]
     filesize_read2: Optional[int]
+    read_group: Optional[str] = None
 
-    @classmethod
-    def from_filepath(cls, filepath: str, filepath_read2: Optional[str] = None):
-        filename = os.path.basename(filepath)
-        try:
-            filesize = os.path.getsize(filepath)
-        except OSError:
-            filesize = 0
-        if filepath_read2:
-            filename_read2 = os.path.basename(filepath_read2)
+    @staticmethod
+    def _names_and_size(filepaths: Union[str, Sequence[str]]
+                        ) -> Tuple[str, int]:
+        if isinstance(filepaths, str):
+            filepaths = [filepaths]
+        total_size = 0
+        for filepath in filepaths:
             try:
-                filesize_read2 = os.path.getsize(filepath_read2)
+                total_size += os.path.getsize(filepath)
             except OSError:
-                filesize_read2 = 0
+                pass
+        return (", ".join(os.path.basename(filepath)
+                          for filepath in filepaths), total_size)
+
+    @classmethod
+    def from_filepath(cls, filepath: Union[str, Sequence[str]],
+                      filepath_read2: Union[None, str, Sequence[str]] = None,
+                      read_group: Optional[str] = None):
+        filename, filesize = cls._names_and_size(filepath)
+        filename_read2: Optional[str]
+        filesize_read2: Optional[int]
+        if filepath_read2:
+            filename_read2, filesize_read2 = cls._names_and_size(
+                filepath_read2)
         else:
             filename_read2 = None
             filesize_read2 = None
@@ -386,7 +399,7 @@ class Meta(ReportModule):
         time_struct = time.localtime(timestamp)
         report_generated = time.strftime("%Y-%m-%d %H:%M:%S%z", time_struct)
         return cls(__version__, report_generated, filename, filesize,
-                   filename_read2, filesize_read2)
+                   filename_read2, filesize_read2, read_group)
 
     def to_html(self) -> str:
         content = io.StringIO()
@@ -407,6 +420,13 @@ class Meta(ReportModule):
                     <td>{self.filesize_read2 / (1024 ** 3):.2f} GiB</td>
                 </tr>
             """)
+        if self.read_group is not None:
+            content.write(f"""
+                <tr>
+                    <td>Read group</td>
+                    <td><code>{html.escape(self.read_group)}</code></td>
+                </tr>
+            """)
         content.write(f"""
             <tr><td>Sequali version</td><td>{self.sequali_version}</td></tr>
             <tr><td>Report generated on</td><td>{self.report_generated}</td></tr>
@@ -428,6 +448,30 @@ class Summary(ReportModule):
     total_n_bases: int
     read_pair_info: Optional[str] = None
 
+    @classmethod
+    def from_qc_metrics(cls, metrics: QCMetrics,
+                        read_pair_info: Optional[str] = None):
+        whole_read = [(0, metrics.max_length)]
+        summary_bases = metrics.base_count_table(ranges=whole_read)
+        summary_phreds = metrics.phred_count_table(ranges=whole_read)
+        total_bases = sum(summary_bases)
+        total_reads = metrics.number_of_reads
+        q20_reads = sum(metrics.phred_scores()[20:])
+        minimum_length = next(
+            (length for length, count in enumerate(metrics.sequence_lengths())
+             if count), 0)
+        return cls(
+            mean_length=total_bases / max(total_reads, 1),
+            minimum_length=minimum_length,
+            maximum_length=metrics.max_length,
+            total_reads=total_reads,
+            total_bases=total_bases,
+            q20_bases=sum(summary_phreds[5:]),
+            q20_reads=q20_reads,
+            total_gc_bases=summary_bases[C] + summary_bases[G],
+            total_n_bases=summary_bases[N],
+            read_pair_info=read_pair_info)
+
     def to_html(self) -> str:
         return f"""
             {html_header("Summary", 1, self.read_pair_info)}
@@ -542,23 +586,11 @@ class SequenceLengthDistribution(ReportModule):
         """
 
     @classmethod
-    def from_base_count_tables(cls,
-                               base_count_tables: array.ArrayType,
-                               total_sequences: int,
-                               data_ranges: Sequence[Tuple[int, int]],
-                               read_pair_info: Optional[str] = None):
-        max_length = len(base_count_tables) // NUMBER_OF_NUCS
-        # use bytes constructor to initialize to 0
-        sequence_lengths = array.array("Q", bytes(8 * (max_length + 1)))
-        base_counts = array.array("Q", bytes(8 * (max_length + 1)))
-        base_counts[0] = total_sequences  # all reads have at least 0 bases
-        for i, table in enumerate(table_iterator(base_count_tables, NUMBER_OF_NUCS)):
-            base_counts[i + 1] = sum(table)
-        previous_count = 0
-        for i in range(max_length, 0, -1):
-            number_at_least = base_counts[i]
-            sequence_lengths[i] = number_at_least - previous_count
-            previous_count = number_at_least
+    def from_sequence_lengths(cls,
+                              sequence_lengths: array.ArrayType,
+                              data_ranges: Sequence[Tuple[int, int]],
+                              read_pair_info: Optional[str] = None):
+        total_sequences = sum(sequence_lengths)
         seqlength_view = memoryview(sequence_lengths)[1:]
         lengths = [sum(seqlength_view[start:stop]) for start, stop in
                    data_ranges]
@@ -588,7 +620,8 @@ class SequenceLengthDistribution(ReportModule):
             if done:
                 break
 
-        total_bases = sum(base_count_tables)
+        total_bases = sum(map(operator.mul, range(len(sequence_lengths)),
+                              sequence_lengths))
         half_bases = total_bases // 2
         ten_percent_bases = int(total_bases * 0.1)
         sum_bases = 0
@@ -1104,7 +1137,7 @@ class AdapterContent(ReportModule):
         all_adapters = []
         sequence_to_adapter = {adapter.sequence: adapter for adapter in adapters}
         adapter_names = [adapter.name for adapter in adapters]
-        total_sequences = adapter_counter.number_of_sequences
+        total_sequences = adapter_counter.sampled_sequences
         for adapter_sequence, countarray in adapter_counter.get_counts():
             adapter = sequence_to_adapter[adapter_sequence]
             adapter_counts = [sum(countarray[start:stop])
@@ -1141,11 +1174,11 @@ class PerTileQualityReport(ReportModule):
             return cls([], [], [], [], ptq.skipped_reason)
         average_phreds = []
         per_category_totals = [0.0 for i in range(len(data_ranges))]
-        tile_counts = ptq.get_tile_counts()
+        tile_counts = ptq.get_tile_counts(ranges=data_ranges)
         for tile, summed_errors, counts in tile_counts:
             range_averages = [
-                sum(summed_errors[start:stop]) / max(sum(counts[start:stop]), 1)
-                for start, stop in data_ranges]
+                range_errors / max(range_count, 1)
+                for range_errors, range_count in zip(summed_errors, counts)]
             range_phreds = []
             for i, average in enumerate(range_averages):
                 if average != 0:
@@ -1412,6 +1445,7 @@ class OverRepresentedSequences(ReportModule):
     total_sequences: int
     sampled_sequences: int
     read_pair_info: Optional[str] = None
+    sketch_memory: int = 0
 
     def to_dict(self) -> Dict[str, Any]:
         return {"overrepresented_sequences":
@@ -1423,7 +1457,8 @@ class OverRepresentedSequences(ReportModule):
                 "total_fragments": self.total_fragments,
                 "total_sequences": self.total_sequences,
                 "sampled_sequences": self.sampled_sequences,
-                "read_pair_info": self.read_pair_info}
+                "read_pair_info": self.read_pair_info,
+                "sketch_memory": self.sketch_memory}
 
     def from_dict(cls, d: Dict[str, List[Dict[str, Any]]]):
         overrepresented_sequences = d["overrepresented_sequences"]
@@ -1436,7 +1471,8 @@ class OverRepresentedSequences(ReportModule):
                    total_fragments=d["total_fragments"],
                    total_sequences=d["total_sequences"],
                    sampled_sequences=d["sampled_sequences"],
-                   read_pair_info=d["read_pair_info"])  # type: ignore
+                   read_pair_info=d["read_pair_info"],  # type: ignore
+                   sketch_memory=d.get("sketch_memory", 0))  # type: ignore
 
     def to_html(self) -> str:
         header = html_header("Overrepresented sequences", 1,
@@ -1445,13 +1481,31 @@ class OverRepresentedSequences(ReportModule):
             return header + "No overrepresented sequences."
         content = io.StringIO()
         content.write(header)
+        if self.sketch_memory:
+            counting_explanation = """Fragments
+            are counted in a count-min sketch, which can overestimate counts
+            but never underestimates them. The fragments with the highest
+            counts are stored, so fragments that become common late in the
+            file are also found."""
+            fragments_name = "Maximum stored fragments"
+            sketch_row = f"""
+            <tr>
+                <td>Sketch memory</td>
+                <td style="text-align:right;">
+                    {self.sketch_memory / (1024 * 1024):,.1f} MiB</td>
+            </tr>"""
+        else:
+            counting_explanation = """Fragments
+            are stored and counted. When the maximum amount of unique fragments
+            is reached, only fragments that are already stored are counted. The
+            rest of the fragments is ignored."""
+            fragments_name = "Maximum unique fragments"
+            sketch_row = ""
         content.write(
             f"""
             <p class="explanation">A subsample of the sequences is analysed
-            Sequences are cut into fragments of up to 31&#8239;bp. Fragments
-            are stored and counted. When the maximum amount of unique fragments
-            is reached, only fragments that are already stored are counted. The
-            rest of the fragments is ignored.
+            Sequences are cut into fragments of up to 31&#8239;bp.
+            {counting_explanation}
             Fragments are stored in their canonical representation. That is
             either the sequence or the reverse complement, whichever has
             the lowest sort order. Both representations are shown in the
@@ -1497,9 +1551,9 @@ class OverRepresentedSequences(ReportModule):
                 <td style="text-align:right;">{self.collected_fragments:,}</td>
             </tr>
             <tr>
-                <td>Maximum unique fragments</td>
+                <td>{fragments_name}</td>
                 <td style="text-align:right;">{self.max_unique_fragments:,}</td>
-            </tr>
+            </tr>{sketch_row}
             <tr>
                 <td>Fragment size</td>
                 <td style="text-align:right;">{self.sequence_length}</td>
@@ -1535,28 +1589,36 @@ class OverRepresentedSequences(ReportModule):
             min_threshold: int = DEFAULT_MIN_THRESHOLD,
             max_threshold: int = DEFAULT_MAX_THRESHOLD,
             read_pair_info: Optional[str] = None,
+            threads: int = 1,
     ):
         overrepresented_sequences = seqdup.overrepresented_sequences(
             fraction_threshold,
             min_threshold,
             max_threshold
         )
-
+        identifications = identify_sequences_builtin(
+            [sequence for _, _, sequence in overrepresented_sequences],
+            threads=threads)
         overrepresented_with_identification = [
             OverRepresentedSequence(
                 count, fraction, sequence, reverse_complement(sequence),
-                *identify_sequence_builtin(sequence))
-            for count, fraction, sequence in overrepresented_sequences
+                *identification)
+            for (count, fraction, sequence), identification
+            in zip(overrepresented_sequences, identifications)
         ]
+        max_unique_fragments = (seqdup.max_heavy_hitters
+                                if seqdup.sketch_memory
+                                else seqdup.max_unique_fragments)
         return cls(overrepresented_with_identification,
-                   seqdup.max_unique_fragments,
+                   max_unique_fragments,
                    seqdup.collected_unique_fragments,
                    seqdup.sample_every,
                    seqdup.fragment_length,
                    seqdup.total_fragments,
                    seqdup.number_of_sequences,
                    seqdup.sampled_sequences,
-                   read_pair_info=read_pair_info)
+                   read_pair_info=read_pair_info,
+                   sketch_memory=seqdup.sketch_memory)
 
 
 @dataclasses.dataclass
@@ -1601,64 +1663,40 @@ class NanoStatsReport(ReportModule):
         duration = run_end_time - run_start_time
         time_slots = 200
         time_per_slot = duration / time_slots
-        time_interval_minutes = (math.ceil(time_per_slot) + 59) // 60
-        time_interval = max(time_interval_minutes * 60, 1)
-        # Use duration + 1 to avoid cases where time_interval x time_slots == duration
-        # which causes the last slot to be missing.
+        # NanoStats keeps its time statistics in bins aligned at whole
+        # multiples of the bin size. Slots must consist of whole bins.
+        seconds_per_bin = nanostats.minutes_per_time_bin * 60
+        time_interval = max(math.ceil(time_per_slot / seconds_per_bin), 1
+                            ) * seconds_per_bin
+        time_bases = []
+        time_reads = []
+        time_active_slots = []
+        qual_percentages_over_time: List[List[float]] = [[] for _ in
+                                                         range(12)]
+        for bases, reads, active_channels, quals in (
+                nanostats.time_slot_statistics(time_interval)):
+            time_bases.append(bases)
+            time_reads.append(reads)
+            time_active_slots.append(active_channels)
+            total = sum(quals)
+            for i, q in enumerate(quals):
+                qual_percentages_over_time[i].append(q / max(total, 1))
         time_ranges = [(start, start + time_interval)
-                       for start in range(0, duration + 1, time_interval)]
-        time_slots = len(time_ranges)
-        time_active_slots_sets: List[Set[int]] = [set() for _ in
-                                                  range(time_slots)]
-        time_bases = [0 for _ in range(time_slots)]
-        time_reads = [0 for _ in range(time_slots)]
-        time_qualities = [[0 for _ in range(12)] for _ in
-                          range(time_slots)]
-        per_channel_bases: Dict[int, int] = defaultdict(lambda: 0)
-        per_channel_cumulative_error: Dict[int, float] = defaultdict(lambda: 0.0)
-        translocation_speeds = [0] * 81
-        total_reads = nanostats.number_of_reads
-        reads_with_parent = 0
-        for readinfo in nanostats.nano_info_iterator():
-            if readinfo.parent_id_hash:
-                reads_with_parent += 1
-            relative_start_time = readinfo.start_time - run_start_time
-            timeslot = relative_start_time // time_interval
-            length = readinfo.length
-            cumulative_error_rate = readinfo.cumulative_error_rate
-            channel_id = readinfo.channel_id
-            if length:
-                phred = round(
-                    -10 * math.log10(cumulative_error_rate / length))
-            else:
-                phred = 0
-            phred_index = min(phred, 47) >> 2
-            time_active_slots_sets[timeslot].add(channel_id)
-            time_bases[timeslot] += length
-            time_reads[timeslot] += 1
-            time_qualities[timeslot][phred_index] += 1
-            per_channel_bases[channel_id] += length
-            per_channel_cumulative_error[channel_id] += cumulative_error_rate
-            read_duration = readinfo.duration
-            if read_duration:
-                translocation_speed = min(round(length / read_duration), 800)
-                translocation_speed //= 10
-                translocation_speeds[translocation_speed] += 1
+                       for start in range(0, len(time_bases) * time_interval,
+                                          time_interval)]
+        per_channel_bases: Dict[int, int] = {}
         per_channel_quality: Dict[int, float] = {}
-        for channel, error_rate in per_channel_cumulative_error.items():
-            total_bases = per_channel_bases[channel]
+        for channel, total_bases, error_rate in (
+                nanostats.channel_statistics()):
+            per_channel_bases[channel] = total_bases
             if total_bases:
                 phred_score = -10 * math.log10(error_rate / total_bases)
             else:
                 phred_score = 0
             per_channel_quality[channel] = phred_score
-        qual_percentages_over_time: List[List[float]] = [[] for _ in
-                                                         range(12)]
-        for quals in time_qualities:
-            total = sum(quals)
-            for i, q in enumerate(quals):
-                qual_percentages_over_time[i].append(q / max(total, 1))
-        time_active_slots = [len(s) for s in time_active_slots_sets]
+        translocation_speeds = nanostats.translocation_speeds()
+        total_reads = nanostats.number_of_reads
+        reads_with_parent = nanostats.reads_with_parent
         return cls(
             x_labels=[f"{cls.seconds_to_hour_minute_notation(start)}-"
                       f"{cls.seconds_to_hour_minute_notation(stop)}"
@@ -1667,8 +1705,8 @@ class NanoStatsReport(ReportModule):
             time_active_channels=time_active_slots,
             time_bases=time_bases,
             time_reads=time_reads,
-            per_channel_bases=dict(sorted(per_channel_bases.items())),
-            per_channel_quality=dict(sorted(per_channel_quality.items())),
+            per_channel_bases=per_channel_bases,
+            per_channel_quality=per_channel_quality,
             translocation_speed=translocation_speeds,
             skipped_reason=nanostats.skipped_reason,
             total_reads=total_reads,
@@ -2024,6 +2062,90 @@ class AdapterFromOverlapReport(ReportModule):
         return report.getvalue()
 
 
+@dataclasses.dataclass
+class ProfileReport(ReportModule):
+    """Where the time of the run was spent. Only added with --profile."""
+    sequencing_technology: Optional[str]
+    threads: int
+    wall_time: float
+    reads: int
+    bytes: int
+    stage_times: Dict[str, float]
+    module_times: Dict[str, float]
+    hash_tables: Dict[str, Dict[str, float]]
+    simd_variants: Dict[str, str]
+
+    @staticmethod
+    def _time_rows(times: Dict[str, float], total_time: float) -> str:
+        return "".join(f"""
+            <tr>
+                <td>{html.escape(name)}</td>
+                <td style="text-align:right;">{seconds:,.3f}</td>
+                <td style="text-align:right;">
+                    {seconds / max(total_time, 1e-9):.2%}
+                </td>
+            </tr>""" for name, seconds in times.items())
+
+    def to_html(self) -> str:
+        wall_time = max(self.wall_time, 1e-9)
+        module_times = dict(sorted(self.module_times.items(),
+                                   key=lambda item: item[1], reverse=True))
+        hash_table_rows = "".join(f"""
+            <tr>
+                <td>{html.escape(name)}</td>
+                <td style="text-align:right;">{stats["size"]:,}</td>
+                <td style="text-align:right;">{stats["load_factor"]:.2%}</td>
+                <td style="text-align:right;">
+                    {stats["mean_probe_length"]:.2f}</td>
+                <td style="text-align:right;">{stats["max_probe_length"]:,}</td>
+            </tr>""" for name, stats in self.hash_tables.items())
+        simd_rows = "".join(
+            f"<tr><td>{html.escape(name)}</td><td>{html.escape(variant)}"
+            f"</td></tr>" for name, variant in self.simd_variants.items())
+        return f"""
+            {html_header("Profile", 1)}
+            <p class="explanation">
+            The time spent in each stage of the run. Module times are
+            summed over all threads, so they can add up to more than the
+            wall time. Reading includes waiting for decompression.
+            </p>
+            <table>
+            <tr><td>Sequencing technology</td>
+                <td>{self.sequencing_technology}</td></tr>
+            <tr><td>Threads</td><td>{self.threads}</td></tr>
+            <tr><td>Wall time</td>
+                <td style="text-align:right;">{self.wall_time:,.3f} s</td></tr>
+            <tr><td>Reads per second</td>
+                <td style="text-align:right;">
+                    {self.reads / wall_time:,.0f}</td></tr>
+            <tr><td>MiB per second</td>
+                <td style="text-align:right;">
+                    {self.bytes / (1024 ** 2) / wall_time:,.2f}</td></tr>
+            </table>
+            {html_header("Stages", 2)}
+            <table>
+            <tr><th>Stage</th><th>Seconds</th><th>Of wall time</th></tr>
+            {self._time_rows(self.stage_times, wall_time)}
+            </table>
+            {html_header("Modules", 2)}
+            <table>
+            <tr><th>Module</th><th>Seconds</th><th>Of wall time</th></tr>
+            {self._time_rows(module_times, wall_time)}
+            </table>
+            {html_header("Hash tables", 2)}
+            <table>
+            <tr><th>Table</th><th>Size</th><th>Load factor</th>
+                <th>Mean probe length</th><th>Max probe length</th></tr>
+            {hash_table_rows}
+            </table>
+            {html_header("SIMD variants", 2)}
+            <table>
+            <tr><th>Function</th><th>Variant</th></tr>
+            {simd_rows}
+            </table>
+        """
+
+
 NAME_TO_CLASS: Dict[str, Type[ReportModule]] = {
     "meta": Meta,
     "summary": Summary,
@@ -2041,6 +2163,7 @@ NAME_TO_CLASS: Dict[str, Type[ReportModule]] = {
     "nanopore_metrics": NanoStatsReport,
     "adapter_content_from_overlap": AdapterFromOverlapReport,
     "insert_size_metrics": InsertSizeMetricsReport,
+    "profile": ProfileReport,
 }
 
 CLASS_TO_NAME: Dict[Type[ReportModule], str] = {
@@ -2063,6 +2186,7 @@ CLASS_TO_ORDER = {
     DuplicationCounts: 13,
     OverRepresentedSequences: 14,
     NanoStatsReport: 15,
+    ProfileReport: 16,
 }
 
 
@@ -2154,43 +2278,13 @@ def qc_metrics_modules(metrics: QCMetrics,
                        data_ranges: Sequence[Tuple[int, int]],
                        read_pair_info: Optional[str] = None,
                        ) -> List[ReportModule]:
-    base_count_tables = metrics.base_count_table()
-    phred_count_table = metrics.phred_count_table()
     x_labels = stringify_ranges(data_ranges)
-    aggregrated_base_matrix = aggregate_count_matrix(
-        base_count_tables, data_ranges, NUMBER_OF_NUCS)
-    aggregated_phred_matrix = aggregate_count_matrix(
-        phred_count_table, data_ranges, NUMBER_OF_PHREDS)
-    summary_bases = aggregate_count_matrix(
-        aggregrated_base_matrix,
-        [(0, len(aggregrated_base_matrix) // NUMBER_OF_NUCS)], NUMBER_OF_NUCS)
-    summary_phreds = aggregate_count_matrix(
-        aggregated_phred_matrix,
-        [(0, len(aggregated_phred_matrix) // NUMBER_OF_PHREDS)],
-        NUMBER_OF_PHREDS)
-    total_bases = sum(summary_bases)
-    minimum_length = 0
-    total_reads = metrics.number_of_reads
-    q20_reads = sum(metrics.phred_scores()[20:])
-    for table in table_iterator(base_count_tables, NUMBER_OF_NUCS):
-        if sum(table) < total_reads:
-            break
-        minimum_length += 1
-    total_gc_bases = summary_bases[C] + summary_bases[G]
+    aggregrated_base_matrix = metrics.base_count_table(ranges=data_ranges)
+    aggregated_phred_matrix = metrics.phred_count_table(ranges=data_ranges)
     return [
-        Summary(
-            mean_length=total_bases / max(total_reads, 1),
-            minimum_length=minimum_length,
-            maximum_length=metrics.max_length,
-            total_reads=total_reads,
-            total_bases=total_bases,
-            q20_bases=sum(summary_phreds[5:]),
-            q20_reads=q20_reads,
-            total_gc_bases=total_gc_bases,
-            total_n_bases=summary_bases[N],
-            read_pair_info=read_pair_info),
-        SequenceLengthDistribution.from_base_count_tables(
-            base_count_tables, total_reads, data_ranges,
+        Summary.from_qc_metrics(metrics, read_pair_info=read_pair_info),
+        SequenceLengthDistribution.from_sequence_lengths(
+            metrics.sequence_lengths(), data_ranges,
             read_pair_info=read_pair_info),
         PerBaseQualityScoreDistribution.from_phred_count_table_and_labels(
             aggregated_phred_matrix, x_labels, read_pair_info=read_pair_info),
@@ -2208,7 +2302,7 @@ def qc_metrics_modules(metrics: QCMetrics,
 
 
 def calculate_stats(
-        filename: str,
+        filename: Union[str, Sequence[str]],
         metrics: QCMetrics,
         per_tile_quality: PerTileQuality,
         sequence_duplication: OverrepresentedSequences,
@@ -2216,7 +2310,7 @@ def calculate_stats(
         nanostats: NanoStats,
         adapters: List[Adapter],
         adapter_counter: Optional[AdapterCounter] = None,
-        filename_reverse: Optional[str] = None,
+        filename_reverse: Union[None, str, Sequence[str]] = None,
         insert_size_metrics: Optional[InsertSizeMetrics] = None,
         metrics_reverse: Optional[QCMetrics] = None,
         per_tile_quality_reverse: Optional[PerTileQuality] = None,
@@ -2225,6 +2319,8 @@ def calculate_stats(
         fraction_threshold: float = DEFAULT_FRACTION_THRESHOLD,
         min_threshold: int = DEFAULT_MIN_THRESHOLD,
         max_threshold: int = DEFAULT_MAX_THRESHOLD,
+        threads: int = 1,
+        read_group: Optional[str] = None,
 ) -> List[ReportModule]:
     read_pair_info1 = READ1 if filename_reverse else None
     max_length = metrics.max_length
@@ -2233,7 +2329,7 @@ def calculate_stats(
     else:
         data_ranges = list(equidistant_ranges(max_length, graph_resolution))
     modules = [
-        Meta.from_filepath(filename, filename_reverse),
+        Meta.from_filepath(filename, filename_reverse, read_group),
         *qc_metrics_modules(metrics, data_ranges, read_pair_info=read_pair_info1),
         PerTileQualityReport.from_per_tile_quality_and_ranges(
             per_tile_quality, data_ranges, read_pair_info=read_pair_info1),
@@ -2243,6 +2339,7 @@ def calculate_stats(
             min_threshold=min_threshold,
             max_threshold=max_threshold,
             read_pair_info=read_pair_info1,
+            threads=threads,
         ),
         DuplicationCounts.from_dedup_estimator(dedup_estimator),
         NanoStatsReport.from_nanostats(nanostats)
@@ -2280,6 +2377,7 @@ def calculate_stats(
             min_threshold=min_threshold,
             max_threshold=max_threshold,
             read_pair_info=READ2,
+            threads=threads,
         ))
     modules.sort(key=module_sort_key)
     return modules
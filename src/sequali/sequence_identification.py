@@ -15,15 +15,27 @@
 # along with Sequali.  If not, see <https://www.gnu.org/licenses/
 import collections
 import functools
+import glob
+import hashlib
 import os
+import sys
+import tempfile
+import time
 import typing
-from typing import Dict, Iterable, Iterator, List, Tuple, Union
+import warnings
+from typing import Dict, Iterable, Iterator, List, Sequence, Tuple, Union
 
-from ._seqident import sequence_identity
+from ._seqident import (
+    SEQUENCE_INDEX_FILE_VERSION, SequenceIndex, sequence_identity)
 from .util import fasta_parser
 
 DEFAULT_K = 13
 
+# Cached indexes of other versions or contaminant files are only removed when
+# they have not been used for this many seconds. Loading an index updates its
+# modification time, so indexes that other installations share are kept.
+SEQUENCE_INDEX_CACHE_MAX_AGE = 30 * 24 * 60 * 60
+
 CONTAMINANTS_DIR = os.path.join(os.path.dirname(__file__), "contaminants")
 DEFAULT_CONTAMINANTS_FILES = [f.path for f in os.scandir(CONTAMINANTS_DIR)
                               if f.name != "README"]
@@ -88,39 +100,134 @@ def canonical_kmers(sequence: str, k: int):
 def create_sequence_index(
         names_and_sequences: Iterable[Tuple[str, str]],
         k: int = DEFAULT_K,
-        ) -> Dict[str, Union[List[str], str]]:
-    sequence_index: Dict[str, Union[List[str], str]] = {}
-    for name, sequence in names_and_sequences:
-        kmers = canonical_kmers(sequence, k)
-        # Store one sequence name (most common) or alternatively a list
-        # of multiple names. This is a bit convoluted, but it
-        # saves a lot of time as memory does not need to be allocated for a
-        # lot of one-item lists.
-        for kmer in kmers:
-            if kmer in sequence_index:
-                prev_entry = sequence_index[kmer]
-                if isinstance(prev_entry, list):
-                    sequence_index[kmer].append(name)  # type: ignore
-                else:
-                    sequence_index[kmer] = [name, prev_entry]
-            else:
-                sequence_index[kmer] = name
-    return sequence_index
+        ) -> SequenceIndex:
+    return SequenceIndex(names_and_sequences, k)
+
+
+def default_cache_dir() -> str:
+    """
+    The directory for cached sequence indexes. Can be set with the
+    SEQUALI_CACHE_DIR environment variable, for instance to a directory that
+    is shared by all nodes of a cluster.
+    """
+    cache_dir = os.environ.get("SEQUALI_CACHE_DIR")
+    if cache_dir:
+        return cache_dir
+    cache_home = (os.environ.get("XDG_CACHE_HOME") or
+                  os.path.join(os.path.expanduser("~"), ".cache"))
+    return os.path.join(cache_home, "sequali")
+
+
+def default_sequence_index_cache_file(k: int = DEFAULT_K) -> str:
+    # The file name changes when the index format or the contents of the
+    # contaminant files change, so an outdated index is never loaded.
+    # Reinstalling the same files gives the same name.
+    hasher = hashlib.sha256()
+    hasher.update(f"{SEQUENCE_INDEX_FILE_VERSION}:{sys.byteorder}".encode())
+    for file in sorted(DEFAULT_CONTAMINANTS_FILES):
+        hasher.update(os.path.basename(file).encode())
+        with open(file, "rb") as file_h:
+            hasher.update(hashlib.sha256(file_h.read()).digest())
+    return os.path.join(default_cache_dir(),
+                        f"contaminants_k{k}_{hasher.hexdigest()[:16]}.idx")
+
+
+def remove_outdated_sequence_indexes(k: int, cache_file: str):
+    """
+    Remove the cached indexes for k other than cache_file that were not used
+    for SEQUENCE_INDEX_CACHE_MAX_AGE seconds.
+    """
+    pattern = os.path.join(glob.escape(os.path.dirname(cache_file)),
+                           f"contaminants_k{k}_*.idx")
+    oldest_mtime = time.time() - SEQUENCE_INDEX_CACHE_MAX_AGE
+    for path in glob.glob(pattern):
+        if path == cache_file:
+            continue
+        try:
+            if os.stat(path).st_mtime < oldest_mtime:
+                os.remove(path)
+        except OSError:
+            # Another process may have removed it already.
+            pass
+
+
+def save_sequence_index(sequence_index: SequenceIndex, path: str):
+    """Save the index such that other processes never see a partial file."""
+    directory = os.path.dirname(path)
+    os.makedirs(directory, exist_ok=True)
+    fd, temp_path = tempfile.mkstemp(dir=directory, suffix=".tmp")
+    os.close(fd)
+    try:
+        sequence_index.save(temp_path)
+        os.chmod(temp_path, 0o644)
+        os.replace(temp_path, path)
+    except BaseException:
+        os.remove(temp_path)
+        raise
 
 
 @functools.lru_cache
-def create_default_sequence_index(k: int = DEFAULT_K
-                                  ) -> Dict[str, Union[List[str], str]]:
-    return create_sequence_index(default_sequence_lookup().items(), k)
+def create_default_sequence_index(k: int = DEFAULT_K) -> SequenceIndex:
+    """
+    Load the index of the builtin contaminants from the cache. When it is not
+    cached yet, the index is created and saved to the cache.
+    """
+    cache_file = default_sequence_index_cache_file(k)
+    try:
+        sequence_index = SequenceIndex.load(cache_file)
+    except (OSError, ValueError):
+        pass
+    else:
+        try:
+            # Mark the index as used, so it is not removed as outdated.
+            os.utime(cache_file)
+        except OSError:
+            # A read-only cache is never pruned by this process either.
+            pass
+        return sequence_index
+    sequence_index = create_sequence_index(default_sequence_lookup().items(), k)
+    try:
+        save_sequence_index(sequence_index, cache_file)
+    except OSError:
+        # Without a writable cache only the startup time is affected.
+        pass
+    else:
+        remove_outdated_sequence_indexes(k, cache_file)
+    return sequence_index
+
+
+def identify_sequence_with_index(
+        sequence: str,
+        sequence_index: SequenceIndex,
+        match_reverse_complement: bool = True,
+) -> Tuple[int, int, str]:
+    """
+    Identify a sequence. Candidates are the sequences with the most k-mers in
+    common. The shortest candidates are aligned first.
+    :return: A tuple of matches, the max matches and a string containing
+             the best match.
+    """
+    return sequence_index.identify(sequence, match_reverse_complement)
 
 
 def identify_sequence(
         sequence: str,
-        sequence_index: Dict[str, Union[List[str], str]],
+        sequence_index: Union[SequenceIndex, Dict[str, Union[List[str], str]]],
         sequence_lookup: Dict[str, str],
         k: int = DEFAULT_K,
         match_reverse_complement: bool = True,
 ) -> Tuple[int, int, str]:
+    """
+    Identify a sequence using an index of k-mers to the names of the
+    sequences they occur in and a lookup of names to sequences.
+
+    Deprecated, use identify_sequence_with_index instead.
+    """
+    warnings.warn("identify_sequence is deprecated, use "
+                  "identify_sequence_with_index instead.",
+                  DeprecationWarning, stacklevel=2)
+    if isinstance(sequence_index, SequenceIndex):
+        return sequence_index.identify(sequence, match_reverse_complement)
     kmers = canonical_kmers(sequence, k)
     counted_seqs: typing.Counter[str] = collections.Counter()
     sequence_reverse_complement = reverse_complement(sequence)
@@ -164,17 +271,32 @@ def identify_sequence_builtin(sequence: str, k: int = DEFAULT_K,
     :return: A tuple of kmer matches, the max matches and a string containing
              the best match.
     """
+    return identify_sequences_builtin([sequence], k,
+                                      match_reverse_complement)[0]
+
+
+def identify_sequences_builtin(sequences: Sequence[str], k: int = DEFAULT_K,
+                               match_reverse_complement: bool = True,
+                               threads: int = 1,
+                               ) -> List[Tuple[int, int, str]]:
+    """
+    Identify multiple sequences using the builtin sequence libraries. The
+    alignments are done with the GIL released on the given number of threads.
+    :return: A list of tuples in the format of identify_sequence_builtin.
+    """
+    results: List[Tuple[int, int, str]] = [(0, 0, "No match")] * len(sequences)
+    to_identify = list(range(len(sequences)))
     while True:
         sequence_index = create_default_sequence_index(k)
-        matches, max_matches, best_match = identify_sequence(
-            sequence, sequence_index, default_sequence_lookup(), k,
-            match_reverse_complement
-        )
-        # Check if the sequence has been adequately identified, if not retry
+        batch_results = sequence_index.identify_batch(
+            [sequences[i] for i in to_identify], match_reverse_complement,
+            threads)
+        for i, result in zip(to_identify, batch_results):
+            results[i] = result
+        # Check if the sequences have been adequately identified, if not retry
         # with a smaller k.
-        if matches != 0:
-            break
+        to_identify = [i for i in to_identify if results[i][0] == 0]
         k -= 2
-        if k < 9:
+        if not to_identify or k < 9:
             break
-    return matches, max_matches, best_match
+    return results
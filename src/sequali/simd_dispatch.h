@@ -0,0 +1,85 @@
+/*
+Copyright (C) 2023 Leiden University Medical Center
+This file is part of Sequali
+
+Sequali is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+Sequali is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with Sequali.  If not, see <https://www.gnu.org/licenses/
+*/
+
+// Runtime CPU dispatch shared by the extension modules. Needs Python.h and
+// compiler_defs.h to be included first.
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The SEQUALI_SIMD environment variable limits the runtime CPU dispatch to
+   'ssse3' or to the 'default' code paths, so all variants can be tested and
+   benchmarked on a single machine. It is read when the module is loaded. */
+#define SIMD_LEVEL_UNKNOWN -1
+#define SIMD_LEVEL_DEFAULT 0
+#define SIMD_LEVEL_SSSE3 1
+#define SIMD_LEVEL_AVX2 2
+
+static inline int
+simd_level_from_environment(void)
+{
+    const char *limit = getenv("SEQUALI_SIMD");
+    if (limit == NULL || strcmp(limit, "avx2") == 0) {
+        return SIMD_LEVEL_AVX2;
+    }
+    if (strcmp(limit, "default") == 0) {
+        return SIMD_LEVEL_DEFAULT;
+    }
+    if (strcmp(limit, "ssse3") == 0) {
+        return SIMD_LEVEL_SSSE3;
+    }
+    return SIMD_LEVEL_UNKNOWN;
+}
+
+/**
+ * @brief Raise a ValueError when SEQUALI_SIMD has an unknown value, so a
+ *        typo does not silently run the fastest code paths. The dispatch
+ *        constructors run before Python can raise, so this is called when
+ *        the module is executed.
+ *
+ * @return int 0 on success, -1 with an exception set otherwise.
+ */
+static inline int
+simd_check_environment(void)
+{
+    if (simd_level_from_environment() == SIMD_LEVEL_UNKNOWN) {
+        PyErr_Format(PyExc_ValueError,
+                     "SEQUALI_SIMD must be 'default', 'ssse3' or 'avx2', "
+                     "got '%s'.",
+                     getenv("SEQUALI_SIMD"));
+        return -1;
+    }
+    return 0;
+}
+
+#if COMPILER_HAS_TARGETED_DISPATCH && BUILD_IS_X86_64
+static inline bool
+cpu_supports_avx2(void)
+{
+    return simd_level_from_environment() >= SIMD_LEVEL_AVX2 &&
+           __builtin_cpu_supports("avx2");
+}
+
+static inline bool
+cpu_supports_ssse3(void)
+{
+    return simd_level_from_environment() >= SIMD_LEVEL_SSSE3 &&
+           __builtin_cpu_supports("ssse3");
+}
+#endif
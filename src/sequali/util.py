@@ -14,12 +14,20 @@
 # You should have received a copy of the GNU Affero General Public License
 # along with Sequali.  If not, see <https://www.gnu.org/licenses/
 
+import collections
+import concurrent.futures
 import io
 import os
+import stat
 import string
+import struct
+import sys
+import time
+import zlib
 from typing import (
     BinaryIO,
     Callable,
+    Deque,
     Iterator,
     List,
     Optional,
@@ -40,6 +48,16 @@ try:
 except ImportError:
     _ThreadedGzipReader = None  # type: ignore
 
+try:
+    from isal import isal_zlib as _zlib
+except ImportError:
+    _zlib = zlib  # type: ignore
+
+BGZF_HEADER_SIZE = 18
+BGZF_TRAILER_SIZE = 8
+# Read from stdin rather than a file. Pipes and FIFOs are read as a stream.
+STDIN_PATH = "-"
+
 
 class ProgressUpdater:
     """
@@ -49,6 +67,9 @@ class ProgressUpdater:
     Because tqdm requires some minor execution time, only call tqdm.update()
     every 10MiB of processed records to prevent too much time spent on
     calling the tell() functions and calling tqdm.update().
+
+    When the file is memory mapped, the file position does not change, so the
+    size of the processed record arrays is used instead.
     """
     _get_position: Callable[[], int]
     previous_file_pos: int
@@ -57,15 +78,21 @@ class ProgressUpdater:
     next_update_at: int
     tqdm: tqdm.tqdm
 
-    def __init__(self, filereader: io.BufferedReader):
+    def __init__(self, filereader: io.BufferedReader,
+                 use_file_position: bool = True):
         self.previous_file_pos = 0
         self.current_processed_bytes = 0
         self.progress_update_every = 1024 * 1024 * 10
         self.next_update_at = self.progress_update_every
         filename = filereader.name
-        total: Optional[int] = os.stat(filename).st_size
-        if filereader.seekable():
+        if not isinstance(filename, str):
+            # Opened from a file descriptor, such as stdin.
+            filename = "stdin"
+        total: Optional[int] = os.fstat(filereader.fileno()).st_size
+        if filereader.seekable() and use_file_position:
             self._get_position = filereader.tell
+        elif filereader.seekable():
+            self._get_position = lambda: self.current_processed_bytes
         else:
             self._get_position = lambda: self.current_processed_bytes
             total = None
@@ -96,6 +123,138 @@ class ProgressUpdater:
             self.previous_file_pos = current_position
 
 
+def is_bgzf(header: bytes) -> bool:
+    """
+    Check if the data starts with a BGZF block header. That is a gzip header
+    with the FEXTRA flag set and a 'BC' subfield that stores the block size.
+    """
+    return (len(header) >= BGZF_HEADER_SIZE and
+            header[:4] == b"\x1f\x8b\x08\x04" and
+            header[12:16] == b"BC\x02\x00")
+
+
+def _bgzf_decompress_blocks(blocks: List[memoryview]) -> bytes:
+    decompressed = []
+    for block in blocks:
+        xlen, = struct.unpack_from("<H", block, 10)
+        crc, isize = struct.unpack_from("<II", block,
+                                        len(block) - BGZF_TRAILER_SIZE)
+        data = _zlib.decompress(block[12 + xlen:-BGZF_TRAILER_SIZE],
+                                wbits=-15)
+        if len(data) != isize:
+            raise ValueError(
+                f"Corrupted BGZF block: expected {isize} bytes, "
+                f"got {len(data)}.")
+        if _zlib.crc32(data) != crc:
+            raise ValueError("Corrupted BGZF block: CRC32 mismatch.")
+        decompressed.append(data)
+    return b"".join(decompressed)
+
+
+class BGZFReader(io.RawIOBase):
+    """
+    Read BGZF compressed data, such as BAM files and bgzipped FASTQ.
+
+    Each BGZF block is an independent gzip member with its size stored in the
+    header. This allows splitting the compressed stream into blocks without
+    inflating it, so batches of blocks are decompressed in parallel on a
+    thread pool. Both zlib and isal release the GIL while decompressing.
+    """
+    def __init__(self, fileobj: BinaryIO, threads: int = 1,
+                 blocks_per_batch: int = 16):
+        if threads < 1:
+            raise ValueError(f"threads must be at least 1, got {threads}")
+        self.fileobj = fileobj
+        self.blocks_per_batch = blocks_per_batch
+        self.executor = concurrent.futures.ThreadPoolExecutor(threads)
+        self.futures: Deque[concurrent.futures.Future] = collections.deque()
+        self.max_pending = threads * 2
+        self.buffer = memoryview(b"")
+        self.compressed_eof = False
+
+    def readable(self) -> bool:
+        return True
+
+    def _read_batch(self) -> List[memoryview]:
+        blocks = []
+        for _ in range(self.blocks_per_batch):
+            header = self.fileobj.read(BGZF_HEADER_SIZE)
+            if not header:
+                self.compressed_eof = True
+                break
+            if not is_bgzf(header):
+                if len(header) < BGZF_HEADER_SIZE:
+                    raise EOFError("Truncated BGZF block header.")
+                raise ValueError("Data is not a valid BGZF block.")
+            bsize, = struct.unpack_from("<H", header, 16)
+            block_size = bsize + 1
+            rest = self.fileobj.read(block_size - BGZF_HEADER_SIZE)
+            if len(rest) != block_size - BGZF_HEADER_SIZE:
+                raise EOFError("Truncated BGZF block.")
+            blocks.append(memoryview(header + rest))
+        return blocks
+
+    def _fill_queue(self):
+        while not self.compressed_eof and len(self.futures) < self.max_pending:
+            blocks = self._read_batch()
+            if blocks:
+                self.futures.append(
+                    self.executor.submit(_bgzf_decompress_blocks, blocks))
+
+    def readinto(self, b) -> int:
+        while not self.buffer:
+            self._fill_queue()
+            if not self.futures:
+                return 0
+            self.buffer = memoryview(self.futures.popleft().result())
+        size = min(len(b), len(self.buffer))
+        memoryview(b).cast("B")[:size] = self.buffer[:size]
+        self.buffer = self.buffer[size:]
+        return size
+
+    def close(self):
+        if not self.closed:
+            for future in self.futures:
+                future.cancel()
+            self.executor.shutdown(wait=True)
+            self.futures.clear()
+        super().close()
+
+
+def open_input(raw: io.BufferedReader, threads: int = 0) -> BinaryIO:
+    """
+    Open a binary file for decompressed reading. BGZF input is decompressed
+    in parallel when threads are available, all other input is handled by
+    xopen.
+    """
+    if threads > 0 and is_bgzf(raw.peek(BGZF_HEADER_SIZE)):
+        return io.BufferedReader(BGZFReader(raw, threads=threads),
+                                 buffer_size=128 * 1024)
+    return xopen.xopen(raw, "rb", threads=threads)
+
+
+def can_mmap(raw: io.BufferedReader) -> bool:
+    """
+    Check if the file is an uncompressed FASTQ file that can be memory mapped.
+    """
+    if os.name == "nt" or not stat.S_ISREG(os.fstat(raw.fileno()).st_mode):
+        return False
+    return raw.peek(1)[:1] == b"@"
+
+
+def split_byte_ranges(size: int, parts: int) -> List[Tuple[int, int]]:
+    """
+    Split a file of size bytes into parts byte ranges of roughly equal size.
+    The ranges can be passed as start and end to a memory mapped FastqParser,
+    which resynchronizes on the first record in the range. This allows
+    parsing one file with multiple parsers in parallel.
+    """
+    if parts < 1:
+        raise ValueError(f"parts must be at least 1, got {parts}")
+    boundaries = [size * i // parts for i in range(parts + 1)]
+    return list(zip(boundaries[:-1], boundaries[1:]))
+
+
 class NGSFile:
     filepath: str
     raw: io.BufferedReader
@@ -104,12 +263,30 @@ class NGSFile:
     reader: Union[BamParser, FastqParser]
     sequencing_technology: Optional[str]
     format: str
+    # The time spent in the parser, including reading the file, and the
+    # number of records and bytes it returned.
+    parse_seconds: float
+    number_of_records: int
+    number_of_bytes: int
 
     def __init__(self, filepath: str, threads: int = 0):
         self.filepath = filepath
-        self.raw = open(filepath, "rb")  # type: ignore
-        self.progress = ProgressUpdater(self.raw)
-        self.file = xopen.xopen(self.raw, "rb", threads=threads)
+        self.parse_seconds = 0.0
+        self.number_of_records = 0
+        self.number_of_bytes = 0
+        if filepath == STDIN_PATH:
+            # Do not close stdin, it is not owned by this object.
+            self.raw = open(sys.stdin.fileno(), "rb", closefd=False)
+        else:
+            self.raw = open(filepath, "rb")  # type: ignore
+        use_mmap = can_mmap(self.raw)
+        self.progress = ProgressUpdater(self.raw,
+                                        use_file_position=not use_mmap)
+        if use_mmap:
+            # Uncompressed FASTQ is parsed directly from a memory mapping.
+            self.file = self.raw
+        else:
+            self.file = open_input(self.raw, threads)
         if filepath.endswith(".bam") or (
                 hasattr(self.file, "peek") and self.file.peek(4)[:4] == b"BAM\1"):
             self.reader = BamParser(self.file)
@@ -117,21 +294,57 @@ class NGSFile:
                 guess_sequencing_technology_from_bam_header(self.reader.header)
             self.format = "BAM"
         else:
-            self.reader = FastqParser(self.file)
+            self.reader = FastqParser(self.file, use_mmap=use_mmap)
             self.sequencing_technology = \
                 guess_sequencing_technology_from_file(self.file)  # type: ignore
             self.format = "FASTQ"
 
+    @property
+    def read_seconds(self) -> float:
+        """The part of parse_seconds spent reading and decompressing."""
+        return self.reader.read_nanoseconds / 1e9
+
+    def _update(self, record_array: FastqRecordArrayView, start: float):
+        self.parse_seconds += time.perf_counter() - start
+        self.number_of_records += len(record_array)
+        self.number_of_bytes += len(record_array.obj)
+        self.progress.update(record_array)
+
     def __iter__(self):
-        for record_array in self.reader:
-            self.progress.update(record_array)
+        while True:
+            start = time.perf_counter()
+            try:
+                record_array = next(self.reader)
+            except StopIteration:
+                return
+            self._update(record_array, start)
             yield record_array
 
     def read(self, number_of_records: int):
+        start = time.perf_counter()
         record_array = self.reader.read(number_of_records)  # type: ignore
-        self.progress.update(record_array)
+        self._update(record_array, start)
         return record_array
 
+    def iter_mates(self, mate: "NGSFile") -> Iterator[
+            Tuple[FastqRecordArrayView, FastqRecordArrayView]]:
+        """
+        Iterate over batches of records and their mates from the mate file.
+        The mate batch is shorter than the record batch when the mate file
+        has fewer records, and longer when it has more.
+        """
+        while True:
+            start = time.perf_counter()
+            record_array, mate_array = self.reader.read_mates(  # type: ignore
+                mate.reader)
+            # The mates are parsed in the same call, so the time is counted
+            # for this file.
+            self._update(record_array, start)
+            mate._update(mate_array, time.perf_counter())
+            if len(record_array) == 0 and len(mate_array) == 0:
+                return
+            yield record_array, mate_array
+
     def close(self):
         self.progress.close()
         self.file.close()
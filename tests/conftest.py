@@ -0,0 +1,25 @@
+# Copyright (C) 2023 Leiden University Medical Center
+# This file is part of Sequali
+#
+# Sequali is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as
+# published by the Free Software Foundation, either version 3 of the
+# License, or (at your option) any later version.
+#
+# Sequali is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with Sequali.  If not, see <https://www.gnu.org/licenses/
+import pytest
+
+
+@pytest.fixture(autouse=True, scope="session")
+def sequali_cache_dir(tmp_path_factory):
+    """Keep the tests from writing sequence indexes to the user's cache."""
+    with pytest.MonkeyPatch.context() as monkeypatch:
+        monkeypatch.setenv("SEQUALI_CACHE_DIR",
+                           str(tmp_path_factory.mktemp("sequali_cache")))
+        yield
@@ -0,0 +1,54 @@
+# Copyright (C) 2023 Leiden University Medical Center
+# This file is part of Sequali
+#
+# Sequali is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as
+# published by the Free Software Foundation, either version 3 of the
+# License, or (at your option) any later version.
+#
+# Sequali is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with Sequali.  If not, see <https://www.gnu.org/licenses/
+from typing import Any, Callable, Sequence, TypeVar
+
+import pytest
+
+T = TypeVar("T")
+
+
+def check_merge(create: Callable[[], T],
+                add: Callable[[T, Any], Any],
+                items: Sequence[Any],
+                results: Callable[[T], Any],
+                split: int = 1) -> T:
+    """
+    Check that adding items to one object gives the same results as adding
+    them to two objects that are merged afterwards. The first ``split`` items
+    go to the first object. Merging with empty objects, in either direction,
+    should not change the results either, and merging an object with itself
+    is refused.
+    :return: The merged object, for module specific checks.
+    """
+    single = create()
+    first = create()
+    second = create()
+    for i, item in enumerate(items):
+        add(single, item)
+        add(first if i < split else second, item)
+    expected = results(single)
+    first.merge(second)  # type: ignore
+    assert results(first) == expected
+    first.merge(create())  # type: ignore
+    assert results(first) == expected
+    empty = create()
+    empty.merge(first)  # type: ignore
+    assert results(empty) == expected
+    with pytest.raises(ValueError) as error:
+        first.merge(first)  # type: ignore
+    error.match("itself")
+    assert results(first) == expected
+    return first
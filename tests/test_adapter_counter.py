@@ -14,11 +14,15 @@
 # You should have received a copy of the GNU Affero General Public License
 # along with Sequali.  If not, see <https://www.gnu.org/licenses/
 
+import random
+
 import pytest
 
 from sequali import AdapterCounter
 from sequali._qc import FastqRecordView, MAX_SEQUENCE_SIZE
 
+from .merge_helpers import check_merge
+
 
 def test_adapter_counter_basic_init():
     adapters = [
@@ -156,3 +160,136 @@ def test_adapter_counter_mixed_lengths():
             index = sequence.find(adapter)
             if index != -1:
                 assert counts[index] > 0
+
+
+@pytest.mark.parametrize("number_of_adapters", [1, 5, 9, 33, 37, 70])
+def test_adapter_counter_many_adapters(number_of_adapters):
+    # Adapters of different lengths are packed together and the matchers
+    # are run in groups. Check each adapter is found at the right position.
+    rng = random.Random(number_of_adapters)
+    adapters = ["".join(rng.choice("ACGT") for _ in range(rng.randint(8, 40)))
+                for _ in range(number_of_adapters)]
+    counter = AdapterCounter(adapters)
+    for i, adapter in enumerate(adapters):
+        sequence = "N" * i + adapter + "N" * 10
+        counter.add_read(FastqRecordView("name", sequence, "H" * len(sequence)))
+    for i, (adapter, counts) in enumerate(counter.get_counts()):
+        assert adapter == adapters[i]
+        assert counts[i] == 1
+        assert sum(counts) == 1
+
+
+def test_adapter_counter_merge():
+    adapters = ["GATTACA", "GGGG", "TTTTT"]
+    sequences = [
+        "AAGATTACAAAAAGATTACAGGGGAACGAGGGG",
+        "TTTTTGATTACA",
+        "GATTACAGATTACAGATTACAGATTACAGATTACAGATTACAGATTACAGATTACA",
+    ]
+    check_merge(
+        lambda: AdapterCounter(adapters),
+        AdapterCounter.add_read,
+        [FastqRecordView("bla", sequence, "H" * len(sequence))
+         for sequence in sequences],
+        lambda counter: (counter.number_of_sequences, counter.max_length,
+                         counter.get_counts()))
+
+
+def test_adapter_counter_dump_load():
+    adapters = ["GATTACA", "GGGG", "TTTTT"]
+    counter = AdapterCounter(adapters, bases_from_start=20, bases_from_end=20)
+    for sequence in ("AAGATTACAAAAAGATTACAGGGGAACGAGGGG", "TTTTTGATTACA"):
+        counter.add_read(FastqRecordView("bla", sequence, "H" * len(sequence)))
+    loaded = AdapterCounter.load(counter.dump())
+    assert loaded.adapters == counter.adapters
+    assert loaded.number_of_sequences == counter.number_of_sequences
+    assert loaded.max_length == counter.max_length
+    assert loaded.get_counts() == counter.get_counts()
+    loaded.merge(counter)
+
+
+def test_adapter_counter_merge_different_adapters():
+    counter = AdapterCounter(["GATTACA"])
+    with pytest.raises(ValueError) as error:
+        counter.merge(AdapterCounter(["GGGG"]))
+    error.match("same adapters")
+
+
+@pytest.mark.parametrize("number_of_adapters", [1, 5, 20])
+def test_adapter_counter_bases_from_start_and_end(number_of_adapters):
+    rng = random.Random(number_of_adapters)
+    # Use the same adapter as filler to test all matcher code paths.
+    adapters = ["GATTACA"] + [
+        "".join(rng.choices("ACGT", k=20))
+        for _ in range(number_of_adapters - 1)]
+    counter = AdapterCounter(adapters, bases_from_start=20, bases_from_end=20)
+    assert counter.bases_from_start == 20
+    assert counter.bases_from_end == 20
+    front = "N" * 5 + "GATTACA" + "N" * 100
+    middle = "N" * 50 + "GATTACA" + "N" * 50
+    back = "N" * 100 + "GATTACA" + "N" * 5
+    for seq in (front, middle, back):
+        counter.add_read(FastqRecordView("bla", seq, "H" * len(seq)))
+    counts = counter.get_counts()[0][1].tolist()
+    assert counts[5] == 1
+    assert counts[100] == 1
+    assert sum(counts) == 2
+
+
+def test_adapter_counter_bases_from_start_and_end_short_read():
+    # Windows that cover the entire read search the entire read.
+    counter = AdapterCounter(["GATTACA"], bases_from_start=20,
+                             bases_from_end=20)
+    sequence = "N" * 15 + "GATTACA" + "N" * 15
+    counter.add_read(FastqRecordView("bla", sequence, "H" * len(sequence)))
+    counts = counter.get_counts()[0][1].tolist()
+    assert counts[15] == 1
+
+
+@pytest.mark.parametrize(["bases_from_start", "bases_from_end", "found"], [
+    (20, -1, [5]),
+    (-1, 20, [100]),
+    # Windows longer than the read search the entire read.
+    (200, -1, [5, 50, 100]),
+    (-1, 200, [5, 50, 100]),
+])
+def test_adapter_counter_one_sided_window(bases_from_start, bases_from_end,
+                                          found):
+    counter = AdapterCounter(["GATTACA"], bases_from_start=bases_from_start,
+                             bases_from_end=bases_from_end)
+    front = "N" * 5 + "GATTACA" + "N" * 100
+    middle = "N" * 50 + "GATTACA" + "N" * 55
+    back = "N" * 100 + "GATTACA" + "N" * 5
+    for seq in (front, middle, back):
+        counter.add_read(FastqRecordView("bla", seq, "H" * len(seq)))
+    counts = counter.get_counts()[0][1].tolist()
+    assert [i for i, count in enumerate(counts) if count] == found
+
+
+@pytest.mark.parametrize("settings", [
+    dict(bases_from_start=20),
+    dict(bases_from_end=20),
+    dict(sample_every=2),
+])
+def test_adapter_counter_merge_different_settings(settings):
+    counter = AdapterCounter(["GATTACA"])
+    with pytest.raises(ValueError) as error:
+        counter.merge(AdapterCounter(["GATTACA"], **settings))
+    error.match("bases_from_start, bases_from_end and sample_every")
+
+
+def test_adapter_counter_sample_every():
+    counter = AdapterCounter(["GATTACA"], sample_every=3)
+    sequence = "AAGATTACAAA"
+    for _ in range(10):
+        counter.add_read(FastqRecordView("bla", sequence, "H" * len(sequence)))
+    assert counter.number_of_sequences == 10
+    assert counter.sampled_sequences == 4
+    assert counter.get_counts()[0][1][2] == 4
+
+
+def test_adapter_counter_sample_every_invalid():
+    with pytest.raises(ValueError) as error:
+        AdapterCounter(["GATTACA"], sample_every=0)
+    error.match("sample_every")
+    error.match("0")
@@ -15,6 +15,8 @@
 # along with Sequali.  If not, see <https://www.gnu.org/licenses/
 
 import io
+import random
+import struct
 from pathlib import Path
 
 import pytest
@@ -143,7 +145,9 @@ def test_bam_parser_too_small_buffer():
 @pytest.mark.parametrize("initial_buffersize", [4, 8, 10, 20, 40])
 def test_small_initial_buffer(initial_buffersize):
     with xopen.xopen(SIMPLE_BAM, "rb") as fileobj:
-        parser = BamParser(fileobj, initial_buffersize=initial_buffersize)
+        # Without adaptation, every batch must be enlarged to fit a record.
+        parser = BamParser(fileobj, initial_buffersize=initial_buffersize,
+                           target_batch_size=0)
         assert len(list(parser)) == 3
 
 
@@ -165,3 +169,62 @@ def test_bam_parser_skip_secondary_supplementary():
         assert len(records) == 2
         assert records[0].name() == "unmapped"
         assert records[1].name() == "everything_but_secondary_and_supplementary"
+
+
+BAM_NUCLEOTIDES = "=ACMGRSVTWYHKDBN"
+
+
+def bam_record(name: str, sequence: str, qualities: bytes) -> bytes:
+    encoded = bytearray()
+    codes = [BAM_NUCLEOTIDES.index(nuc) for nuc in sequence]
+    if len(codes) % 2:
+        codes.append(0)
+    for upper, lower in zip(codes[::2], codes[1::2]):
+        encoded.append(upper << 4 | lower)
+    read_name = name.encode("ascii") + b"\x00"
+    # refID, pos, l_read_name, mapq, bin, n_cigar_op, flag, l_seq,
+    # next_refID, next_pos, tlen
+    fields = struct.pack("<iiBBHHHiiii", -1, -1, len(read_name), 255, 4680,
+                         0, 4, len(sequence), -1, -1, 0)
+    data = fields + read_name + bytes(encoded) + qualities
+    return struct.pack("<I", len(data)) + data
+
+
+def test_bam_parser_decode_all_lengths():
+    # Vectorized decoding handles up to 64 nucleotides at once. Test lengths
+    # around the vector sizes and all nucleotide codes.
+    rng = random.Random(42)
+    records = []
+    for length in range(300):
+        sequence = "".join(rng.choice(BAM_NUCLEOTIDES) for _ in range(length))
+        qualities = bytes(rng.randrange(94) for _ in range(length))
+        records.append((f"read{length}", sequence, qualities))
+    bam = (b"BAM\x01" + struct.pack("<I", 0) + struct.pack("<I", 0) +
+           b"".join(bam_record(*record) for record in records))
+    parser = BamParser(io.BytesIO(bam))
+    parsed = [view for record_array in parser for view in record_array]
+    assert len(parsed) == len(records)
+    for view, (name, sequence, qualities) in zip(parsed, records):
+        assert view.name() == name
+        assert view.sequence() == sequence
+        assert view.qualities() == "".join(chr(q + 33) for q in qualities)
+
+
+def test_bam_parser_adapts_read_in_size():
+    target_batch_size = 64 * 1024
+    with xopen.xopen(DATA / "dorado_nanopore_100reads.bam", "rb") as fileobj:
+        parser = BamParser(fileobj, initial_buffersize=1024,
+                           target_batch_size=target_batch_size)
+        number_of_records = sum(len(record_array) for record_array in parser)
+    assert number_of_records == 100
+    # The records are decoded into a copy, so they take up a large part of
+    # the working set.
+    assert parser.read_in_size <= target_batch_size // 2
+
+
+def test_bam_parser_fixed_read_in_size():
+    with xopen.xopen(SIMPLE_BAM, "rb") as fileobj:
+        parser = BamParser(fileobj, initial_buffersize=1024,
+                           target_batch_size=0)
+        list(parser)
+    assert parser.read_in_size == 1024
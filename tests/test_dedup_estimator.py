@@ -21,6 +21,8 @@ import pytest
 
 from sequali._qc import DedupEstimator
 
+from .merge_helpers import check_merge
+
 
 def test_dedup_estimator():
     dedup_est = DedupEstimator(160)
@@ -52,6 +54,24 @@ def test_dedup_estimator_switches_modulo():
     assert dedup_est._modulo_bits == 6
 
 
+def test_dedup_estimator_switches_modulo_keeps_entries():
+    # The hash table is rehashed in place when the modulo switches. All the
+    # remaining entries should still be found afterwards.
+    dedup_est = DedupEstimator(179)
+    ten_alphabets = [string.ascii_letters] * 10
+    sequences = ["".join(letters) for letters, _ in
+                 zip(itertools.product(*ten_alphabets), range(10000))]
+    for seq in sequences:
+        dedup_est.add_sequence(seq)
+    tracked_sequences = dedup_est.tracked_sequences
+    modulo_bits = dedup_est._modulo_bits
+    for seq in sequences:
+        dedup_est.add_sequence(seq)
+    assert dedup_est._modulo_bits == modulo_bits
+    assert dedup_est.tracked_sequences == tracked_sequences
+    assert list(dedup_est.duplication_counts()) == [2] * tracked_sequences
+
+
 @pytest.mark.parametrize(
     ["front_sequence_length",
      "front_sequence_offset",
@@ -187,3 +207,67 @@ def test_dedup_estimator_offsets_and_lengths_paired(
     for sequence1, sequence2 in input_sequence_pairs:
         dedup_est.add_sequence_pair(sequence1, sequence2)
     assert set(dedup_est.duplication_counts()) == result
+
+
+def test_dedup_estimator_merge():
+    ten_alphabets = [string.ascii_letters] * 10
+    sequences = ["".join(letters) for letters in
+                 itertools.islice(itertools.product(*ten_alphabets), 2000)]
+    sequences += ["duplicated"] * 100
+    check_merge(
+        lambda: DedupEstimator(179),
+        DedupEstimator.add_sequence,
+        sequences,
+        lambda dedup_est: (dedup_est._modulo_bits,
+                           dedup_est.tracked_sequences,
+                           sorted(dedup_est.duplication_counts())),
+        split=100)
+
+
+def test_dedup_estimator_dump_load():
+    ten_alphabets = [string.ascii_letters] * 10
+    sequences = ["".join(letters) for letters in
+                 itertools.islice(itertools.product(*ten_alphabets), 2000)]
+    dedup_est = DedupEstimator(179, front_sequence_offset=2)
+    for seq in sequences:
+        dedup_est.add_sequence(seq)
+    for _ in range(100):
+        dedup_est.add_sequence("duplicated")
+    loaded = DedupEstimator.load(dedup_est.dump())
+    assert loaded._modulo_bits == dedup_est._modulo_bits
+    assert loaded.tracked_sequences == dedup_est.tracked_sequences
+    assert sorted(loaded.duplication_counts()) == sorted(
+        dedup_est.duplication_counts())
+    # The settings are restored, so the objects can be merged.
+    loaded.merge(dedup_est)
+
+
+def test_dedup_estimator_merge_self():
+    dedup_est = DedupEstimator(179)
+    for i in range(2000):
+        dedup_est.add_sequence(f"sequence{i}")
+    counts = sorted(dedup_est.duplication_counts())
+    with pytest.raises(ValueError) as error:
+        dedup_est.merge(dedup_est)
+    error.match("itself")
+    assert sorted(dedup_est.duplication_counts()) == counts
+
+
+def test_dedup_estimator_merge_different_settings():
+    dedup_est = DedupEstimator(front_sequence_length=8)
+    with pytest.raises(ValueError) as error:
+        dedup_est.merge(DedupEstimator(front_sequence_length=6))
+    error.match("lengths and offsets")
+
+
+def test_dedup_estimator_hash_table_stats():
+    dedup_est = DedupEstimator(179)
+    assert dedup_est.hash_table_stats()["used"] == 0
+    for i in range(100):
+        dedup_est.add_sequence(f"sequence{i}")
+        dedup_est.add_sequence(f"sequence{i}")
+    stats = dedup_est.hash_table_stats()
+    assert stats["used"] == dedup_est.tracked_sequences
+    assert stats["size"] >= stats["used"]
+    assert stats["load_factor"] == stats["used"] / stats["size"]
+    assert 0.0 <= stats["mean_probe_length"] <= stats["max_probe_length"]
@@ -16,11 +16,15 @@
 
 import io
 import re
+import sys
+import threading
 from pathlib import Path
 
 import pytest
 
-from sequali import FastqParser
+from sequali import FastqParser, QCMetrics
+from sequali._qc import simd_variants
+from sequali.util import split_byte_ranges
 
 DATA = Path(__file__).parent / "data"
 
@@ -94,6 +98,21 @@ def test_fastq_parser_non_ascii_input():
     error.match("Ä")
 
 
+@pytest.mark.parametrize("record_number", [0, 1, 37, 99])
+def test_fastq_parser_non_ascii_later_in_file(record_number):
+    # Newlines and non-ASCII characters are searched in windows of several
+    # kilobytes. Test positions in different windows and window tails.
+    data = (DATA / "100_illumina_adapters.fastq").read_bytes()
+    lines = data.splitlines(keepends=True)
+    lines[record_number * 4] = lines[record_number * 4][:-1] + "é\n".encode(
+        "latin-1")
+    parser = FastqParser(io.BytesIO(b"".join(lines)), initial_buffersize=8192)
+    with pytest.raises(ValueError) as error:
+        list(parser)
+    error.match("ASCII")
+    error.match("é")
+
+
 def test_fastq_parser_too_small_buffer():
     with pytest.raises(ValueError) as error:
         FastqParser(io.BytesIO(), initial_buffersize=0)
@@ -117,7 +136,8 @@ def test_fastq_record_array_read(number_of_records):
         third_record_array = parser.read(100)
     assert len(record_array) == number_of_records
     assert len(second_record_array) == 100 - number_of_records
-    assert second_record_array.obj.count(b'\n') == (100 - number_of_records) * 4
+    assert (bytes(second_record_array.obj).count(b'\n') ==
+            (100 - number_of_records) * 4)
     assert len(third_record_array) == 0
     assert third_record_array.obj == b""
 
@@ -132,6 +152,377 @@ def test_fastq_record_array_read_buffersizes(buffer_size):
     assert len(record_array) == 20
     assert len(second_record_array) == 70
     assert len(third_record_array) == 10
-    assert record_array.obj.count(b"\n") >= 20 * 4
-    assert second_record_array.obj.count(b"\n") >= 70 * 4
-    assert third_record_array.obj.count(b"\n") == 10 * 4
+    assert bytes(record_array.obj).count(b"\n") >= 20 * 4
+    assert bytes(second_record_array.obj).count(b"\n") >= 70 * 4
+    assert bytes(third_record_array.obj).count(b"\n") == 10 * 4
+
+
+def fastq_records(data):
+    lines = data.splitlines()
+    return [(lines[i][1:].decode(), lines[i + 1].decode(),
+             lines[i + 3].decode()) for i in range(0, len(lines), 4)]
+
+
+def record_array_records(record_array):
+    return [(record.name(), record.sequence(), record.qualities())
+            for record in record_array]
+
+
+@pytest.mark.parametrize("keep_record_arrays", [True, False])
+def test_fastq_parser_buffer_reuse(keep_record_arrays):
+    # Buffers are reused once no record array references them anymore.
+    # Buffers of record arrays that are still alive must not be overwritten.
+    data = (DATA / "100_illumina_adapters.fastq").read_bytes()
+    parser = FastqParser(io.BytesIO(data), initial_buffersize=512)
+    record_arrays = []
+    records = []
+    for record_array in parser:
+        records.extend(record_array_records(record_array))
+        if keep_record_arrays:
+            record_arrays.append(record_array)
+    assert records == fastq_records(data)
+    kept_records = []
+    for record_array in record_arrays:
+        kept_records.extend(record_array_records(record_array))
+    if keep_record_arrays:
+        assert kept_records == records
+
+
+def test_fastq_parser_buffers_read_only():
+    # Pooled buffers are rewritten and the records point into them, so they
+    # are exposed as read-only views that block resizing.
+    data = (DATA / "100_illumina_adapters.fastq").read_bytes()
+    parser = FastqParser(io.BytesIO(data), initial_buffersize=512)
+    records = []
+    for record_array in parser:
+        assert isinstance(record_array.obj, memoryview)
+        assert record_array.obj.readonly
+        with pytest.raises(TypeError):
+            record_array.obj[0] = 0
+        with pytest.raises(BufferError):
+            record_array.obj.obj.clear()
+        with pytest.raises(BufferError):
+            record_array.obj.obj.extend(b"X" * 10)
+        records.extend(record_array_records(record_array))
+    assert records == fastq_records(data)
+
+
+class ShortReadsIO(io.BytesIO):
+    def readinto(self, buffer):
+        # Return less data than requested, like pipes can do.
+        with memoryview(buffer) as view:
+            return super().readinto(view[:7])
+
+
+def test_fastq_parser_not_reentrant():
+    # Reading can release the GIL, so another thread could use the parser
+    # while its buffers are changed. This is simulated with a file object
+    # that uses the parser while it is being read.
+    errors = []
+
+    class ReentrantIO(io.BytesIO):
+        def readinto(self, buffer):
+            try:
+                parser.read(1)
+            except RuntimeError as error:
+                errors.append(error)
+            return super().readinto(buffer)
+
+    data = (DATA / "100_illumina_adapters.fastq").read_bytes()
+    parser = FastqParser(ReentrantIO(data), initial_buffersize=1024)
+    records = []
+    for record_array in parser:
+        records.extend(record_array_records(record_array))
+    assert records == fastq_records(data)
+    assert errors
+    assert "already reading" in str(errors[0])
+
+
+def test_fastq_parser_short_reads():
+    data = (DATA / "100_illumina_adapters.fastq").read_bytes()
+    parser = FastqParser(ShortReadsIO(data), initial_buffersize=1024)
+    records = []
+    for record_array in parser:
+        records.extend(record_array_records(record_array))
+    assert records == fastq_records(data)
+
+
+@pytest.mark.skipif(sys.platform == "win32",
+                    reason="Memory mapping is not supported on Windows")
+@pytest.mark.parametrize("initial_buffersize", [1, 512, 128 * 1024])
+def test_fastq_parser_mmap(initial_buffersize):
+    data = (DATA / "100_illumina_adapters.fastq").read_bytes()
+    with open(DATA / "100_illumina_adapters.fastq", "rb") as fileobj:
+        parser = FastqParser(fileobj, initial_buffersize, use_mmap=True)
+        record_arrays = list(parser)
+    records = []
+    for record_array in record_arrays:
+        records.extend(record_array_records(record_array))
+    assert records == fastq_records(data)
+    # Without copying, the record arrays contain exactly the file data.
+    assert b"".join(bytes(record_array.obj)
+                    for record_array in record_arrays) == data
+    if initial_buffersize < len(data):
+        assert len(record_arrays) > 1
+
+
+@pytest.mark.skipif(sys.platform == "win32",
+                    reason="Memory mapping is not supported on Windows")
+@pytest.mark.parametrize("number_of_records", [1, 20, 99, 100])
+def test_fastq_parser_mmap_read(number_of_records):
+    with open(DATA / "100_illumina_adapters.fastq", "rb") as fileobj:
+        parser = FastqParser(fileobj, use_mmap=True)
+        record_array = parser.read(number_of_records)
+        second_record_array = parser.read(100)
+        third_record_array = parser.read(100)
+    assert len(record_array) == number_of_records
+    assert len(second_record_array) == 100 - number_of_records
+    assert len(third_record_array) == 0
+    assert len(third_record_array.obj) == 0
+
+
+@pytest.mark.skipif(sys.platform == "win32",
+                    reason="Memory mapping is not supported on Windows")
+@pytest.mark.parametrize(["data", "error_type", "message"], [
+    (COMPLETE_RECORD[:-1], EOFError, "ncomplete record"),
+    ("@nÄmé \nAGC\n+\nHHH\n".encode("latin-1"), ValueError, "ASCII"),
+    (b"not a record", ValueError, "Record does not start with @"),
+])
+def test_fastq_parser_mmap_errors(tmp_path, data, error_type, message):
+    fastq = tmp_path / "test.fastq"
+    fastq.write_bytes(data)
+    with open(fastq, "rb") as fileobj:
+        parser = FastqParser(fileobj, use_mmap=True)
+        with pytest.raises(error_type) as error:
+            list(parser)
+    error.match(message)
+
+
+@pytest.mark.skipif(sys.platform == "win32",
+                    reason="Memory mapping is not supported on Windows")
+def test_fastq_parser_mmap_empty_file():
+    with open(DATA / "empty.fastq", "rb") as fileobj:
+        parser = FastqParser(fileobj, use_mmap=True)
+        assert list(parser) == []
+
+
+@pytest.mark.skipif(sys.platform == "win32",
+                    reason="Memory mapping is not supported on Windows")
+def test_fastq_parser_mmap_starts_at_file_position():
+    with open(DATA / "simple.fastq", "rb") as fileobj:
+        fileobj.readline()
+        fileobj.readline()
+        fileobj.readline()
+        fileobj.readline()
+        parser = FastqParser(fileobj, use_mmap=True)
+        records = list(parser)[0]
+    assert len(records) == 2
+    assert records[0].name() == "AnotherHeader/1"
+
+
+def test_fastq_parser_mmap_not_a_file():
+    with pytest.raises(OSError):
+        FastqParser(io.BytesIO(COMPLETE_RECORD), use_mmap=True)
+
+
+def parse_byte_range(path, start, end, initial_buffersize=128 * 1024):
+    with open(path, "rb") as fileobj:
+        parser = FastqParser(fileobj, initial_buffersize, use_mmap=True,
+                             start=start, end=end)
+        records = []
+        for record_array in parser:
+            records.extend(record_array_records(record_array))
+    return records
+
+
+@pytest.mark.skipif(sys.platform == "win32",
+                    reason="Memory mapping is not supported on Windows")
+def test_fastq_parser_byte_range_every_split():
+    path = DATA / "100_illumina_adapters.fastq"
+    data = path.read_bytes()
+    expected = fastq_records(data)
+    for split in range(len(data) + 1):
+        records = (parse_byte_range(path, 0, split, 1024) +
+                   parse_byte_range(path, split, None, 1024))
+        assert records == expected, split
+
+
+@pytest.mark.skipif(sys.platform == "win32",
+                    reason="Memory mapping is not supported on Windows")
+def test_fastq_parser_byte_range_ambiguous_qualities(tmp_path):
+    # Quality lines may start with '@' or '+' which are also the first
+    # characters of header lines.
+    data = (b"@read1\nACGT\n+\n@@@@\n"
+            b"@read2\nAC\n+read2\n+@\n"
+            b"@read3\nGATTACA\n+\n@IIIIII\n"
+            b"@read4\nT\n+\n@\n")
+    path = tmp_path / "ambiguous.fastq"
+    path.write_bytes(data)
+    expected = fastq_records(data)
+    for split in range(len(data) + 1):
+        records = (parse_byte_range(path, 0, split) +
+                   parse_byte_range(path, split, len(data)))
+        assert records == expected, split
+
+
+@pytest.mark.skipif(sys.platform == "win32",
+                    reason="Memory mapping is not supported on Windows")
+@pytest.mark.parametrize("parts", [1, 2, 3, 7])
+def test_fastq_parser_byte_ranges_in_threads(parts):
+    path = DATA / "100_illumina_adapters.fastq"
+    size = path.stat().st_size
+    ranges = split_byte_ranges(size, parts)
+    metrics = [QCMetrics() for _ in ranges]
+
+    def parse(start, end, qc_metrics):
+        with open(path, "rb") as fileobj:
+            parser = FastqParser(fileobj, 512, use_mmap=True, start=start,
+                                 end=end)
+            for record_array in parser:
+                qc_metrics.add_record_array(record_array)
+
+    threads = [threading.Thread(target=parse, args=(start, end, qc_metrics))
+               for (start, end), qc_metrics in zip(ranges, metrics)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    merged = metrics[0]
+    for qc_metrics in metrics[1:]:
+        merged.merge(qc_metrics)
+    serial = QCMetrics()
+    with open(path, "rb") as fileobj:
+        for record_array in FastqParser(fileobj):
+            serial.add_record_array(record_array)
+    assert merged.number_of_reads == serial.number_of_reads == 100
+    assert merged.base_count_table() == serial.base_count_table()
+    assert merged.phred_count_table() == serial.phred_count_table()
+
+
+@pytest.mark.parametrize(["kwargs", "message"], [
+    (dict(start=10), "use_mmap"),
+    (dict(end=10), "use_mmap"),
+    (dict(use_mmap=True, start=-1), "Invalid byte range"),
+    (dict(use_mmap=True, start=10, end=5), "Invalid byte range"),
+])
+def test_fastq_parser_byte_range_invalid(kwargs, message):
+    with open(DATA / "simple.fastq", "rb") as fileobj:
+        with pytest.raises(ValueError) as error:
+            FastqParser(fileobj, **kwargs)
+    error.match(message)
+
+
+def test_fastq_record_array_read_end_of_file_records():
+    # When the end of the file is reached while enlarging the buffer, the
+    # records parsed before must point into the final buffer.
+    data = (DATA / "100_illumina_adapters.fastq").read_bytes()
+    parser = FastqParser(io.BytesIO(data), 128)
+    parser.read(90)
+    record_array = parser.read(50)
+    assert record_array_records(record_array) == fastq_records(data)[90:]
+
+
+def test_fastq_parser_adapts_read_in_size():
+    data = (DATA / "100_illumina_adapters.fastq").read_bytes() * 100
+    target_batch_size = 64 * 1024
+    parser = FastqParser(io.BytesIO(data), 1024,
+                         target_batch_size=target_batch_size)
+    assert parser.read_in_size == 1024
+    record_arrays = list(parser)
+    # The FastqMeta arrays are part of the working set, so the records are
+    # read in smaller chunks than the target.
+    assert 4096 <= parser.read_in_size < target_batch_size
+    assert parser.read_in_size % 4096 == 0
+    records = []
+    for record_array in record_arrays:
+        records.extend(record_array_records(record_array))
+    assert records == fastq_records(data)
+
+
+def test_fastq_parser_fixed_read_in_size():
+    data = (DATA / "100_illumina_adapters.fastq").read_bytes() * 10
+    parser = FastqParser(io.BytesIO(data), 1024, target_batch_size=0)
+    list(parser)
+    assert parser.read_in_size == 1024
+
+
+def test_fastq_parser_negative_target_batch_size():
+    with pytest.raises(ValueError) as error:
+        FastqParser(io.BytesIO(), target_batch_size=-1)
+    error.match("target_batch_size")
+
+
+def fastq_data(names):
+    return b"".join(f"@{name}\nACGT\n+\nIIII\n".encode() for name in names)
+
+
+@pytest.mark.parametrize("initial_buffersize", [16, 1024, 128 * 1024])
+def test_fastq_parser_read_mates(initial_buffersize):
+    names = [f"read{i}" for i in range(200)]
+    parser = FastqParser(io.BytesIO(fastq_data(f"{name}/1" for name in names)),
+                         initial_buffersize)
+    mate_parser = FastqParser(
+        io.BytesIO(fastq_data(f"{name}/2" for name in names)), 64)
+    mate_names = []
+    while True:
+        record_array, mate_array = parser.read_mates(mate_parser)
+        assert len(record_array) == len(mate_array)
+        if len(record_array) == 0:
+            break
+        assert record_array.is_mate(mate_array)
+        mate_names.extend(record.name() for record in mate_array)
+    assert mate_names == [f"{name}/2" for name in names]
+
+
+def test_fastq_parser_read_mates_mismatching_names():
+    parser = FastqParser(io.BytesIO(fastq_data(["a", "b", "c"])))
+    mate_parser = FastqParser(io.BytesIO(fastq_data(["a", "x", "c"])))
+    with pytest.raises(RuntimeError) as error:
+        parser.read_mates(mate_parser)
+    error.match("Mismatching names found! b x")
+
+
+def test_fastq_parser_read_mates_mate_shorter():
+    parser = FastqParser(io.BytesIO(fastq_data(["a", "b", "c"])))
+    mate_parser = FastqParser(io.BytesIO(fastq_data(["a", "b"])))
+    record_array, mate_array = parser.read_mates(mate_parser)
+    assert len(record_array) == 3
+    assert len(mate_array) == 2
+
+
+def test_fastq_parser_read_mates_mate_longer():
+    parser = FastqParser(io.BytesIO(fastq_data(["a", "b"])))
+    mate_parser = FastqParser(io.BytesIO(fastq_data(["a", "b", "c"])))
+    record_array, mate_array = parser.read_mates(mate_parser)
+    assert len(record_array) == len(mate_array) == 2
+    record_array, mate_array = parser.read_mates(mate_parser)
+    assert len(record_array) == 0
+    assert [record.name() for record in mate_array] == ["c"]
+
+
+def test_fastq_parser_read_mates_wrong_type():
+    parser = FastqParser(io.BytesIO(fastq_data(["a"])))
+    with pytest.raises(TypeError) as error:
+        parser.read_mates(io.BytesIO())
+    error.match("FastqParser")
+
+
+def test_fastq_parser_read_nanoseconds():
+    parser = FastqParser(io.BytesIO(fastq_data(["a", "b"])))
+    assert parser.read_nanoseconds == 0
+    list(parser)
+    assert parser.read_nanoseconds > 0
+
+
+def test_simd_variants():
+    variants = simd_variants()
+    for function in ("scan_newlines", "decode_bam_sequence",
+                     "decode_bam_qualities", "count_sequence",
+                     "count_qualities", "find_four_matchers",
+                     "find_sixteen_matchers", "find_overlap",
+                     "sequence_to_canonical_kmer"):
+        assert function in variants
+    # The adapter matchers are dispatched together.
+    assert variants["find_four_matchers"] == variants["find_sixteen_matchers"]
+    assert all(variant in ("default", "ssse3", "avx2")
+               for variant in variants.values())
@@ -41,3 +41,30 @@ def test_names_are_mates(forward: str, reverse: str, expected: bool):
     forward_array = FastqRecordArrayView([forward_record])
     reverse_array = FastqRecordArrayView([reverse_record])
     assert forward_array.is_mate(reverse_array) is expected
+
+
+def test_split_by_read_group():
+    records = [
+        FastqRecordView("r1", "ACGT", "IIII", b"RGZlane1\0"),
+        FastqRecordView("r2", "A", "I"),
+        FastqRecordView("r3", "GG", "II", b"chs\1\0RGZlane2\0"),
+        FastqRecordView("r4", "T", "I", b"RGZlane1\0"),
+        FastqRecordView("r5", "C", "I", b"RGZlane1\0"),
+    ]
+    groups = FastqRecordArrayView(records).split_by_read_group()
+    assert list(groups.keys()) == ["lane1", None, "lane2"]
+    assert [record.name() for record in groups["lane1"]] == ["r1", "r4", "r5"]
+    assert [record.name() for record in groups[None]] == ["r2"]
+    assert [record.sequence() for record in groups["lane2"]] == ["GG"]
+    assert groups["lane2"][0].tags() == b"chs\1\0RGZlane2\0"
+
+
+def test_split_by_read_group_empty():
+    assert FastqRecordArrayView([]).split_by_read_group() == {}
+
+
+def test_split_by_read_group_wrong_type():
+    records = [FastqRecordView("r1", "ACGT", "IIII", b"RGi\1\0\0\0")]
+    with pytest.raises(RuntimeError) as error:
+        FastqRecordArrayView(records).split_by_read_group()
+    error.match("RG")
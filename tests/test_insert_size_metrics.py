@@ -14,10 +14,14 @@
 # You should have received a copy of the GNU Affero General Public License
 # along with Sequali.  If not, see <https://www.gnu.org/licenses/
 
+import random
+
 import pytest
 
 from sequali._qc import INSERT_SIZE_MAX_ADAPTER_STORE_SIZE, InsertSizeMetrics
 
+from .merge_helpers import check_merge
+
 ILLUMINA_ADAPTER_R1 = "AGATCGGAAGAGCACACGTCTGAACTCCAGTCA"
 ILLUMINA_ADAPTER_R2 = "AGATCGGAAGAGCGTCGTGTAGGGAAAGAGTGT"
 
@@ -78,3 +82,81 @@ def test_insert_size_metrics(sequence1, sequence2, insert_size):
         assert insert_size_metrics.number_of_adapters_read2 == 1
     else:
         assert insert_size_metrics.number_of_adapters_read2 == 0
+
+
+def test_insert_size_metrics_merge():
+    pairs = [
+        ("ACGTTGCAGCTATCGA" + ILLUMINA_ADAPTER_R1,
+         "TCGATAGCTGCAACGT" + ILLUMINA_ADAPTER_R2),
+        ("GTACACGTTGCAGCTATCGA" + ILLUMINA_ADAPTER_R1,
+         "TCGATAGCTGCAACGTGTAC" + ILLUMINA_ADAPTER_R2),
+        ("ATATATATATATATAT", "ATATATATATATATAT"),
+    ]
+    check_merge(
+        InsertSizeMetrics,
+        lambda metrics, pair: metrics.add_sequence_pair(*pair),
+        pairs,
+        lambda metrics: (metrics.total_reads,
+                         metrics.number_of_adapters_read1,
+                         metrics.number_of_adapters_read2,
+                         metrics.insert_sizes(),
+                         sorted(metrics.adapters_read1()),
+                         sorted(metrics.adapters_read2())))
+
+
+def test_insert_size_metrics_dump_load():
+    metrics = InsertSizeMetrics()
+    metrics.add_sequence_pair("ACGTTGCAGCTATCGA" + ILLUMINA_ADAPTER_R1,
+                              "TCGATAGCTGCAACGT" + ILLUMINA_ADAPTER_R2)
+    metrics.add_sequence_pair("ATATATATATATATAT", "ATATATATATATATAT")
+    loaded = InsertSizeMetrics.load(metrics.dump())
+    assert loaded.total_reads == metrics.total_reads
+    assert loaded.number_of_adapters_read1 == metrics.number_of_adapters_read1
+    assert loaded.number_of_adapters_read2 == metrics.number_of_adapters_read2
+    assert loaded.insert_sizes() == metrics.insert_sizes()
+    assert loaded.adapters_read1() == metrics.adapters_read1()
+    assert loaded.adapters_read2() == metrics.adapters_read2()
+
+
+COMPLEMENT = str.maketrans("ACGT", "TGCA")
+
+
+@pytest.mark.parametrize("mismatch", [None, 0, 7, 15])
+@pytest.mark.parametrize("insert_size", [16, 31, 32, 47, 48, 63, 64, 100,
+                                         134, 149, 150])
+def test_insert_size_metrics_long_reads(insert_size, mismatch):
+    # Read 2 has more bases than the insert, so the start of read 2 is
+    # searched. Positions in the vectorized part and the tail are tested.
+    fragment = "".join(random.Random(insert_size).choices("ACGT",
+                                                           k=insert_size))
+    sequence1 = (fragment + ILLUMINA_ADAPTER_R1 * 5)[:150]
+    sequence2 = (fragment.translate(COMPLEMENT)[::-1] +
+                 ILLUMINA_ADAPTER_R2 * 5)[:151]
+    if mismatch is not None:
+        position = insert_size - 16 + mismatch
+        replacement = "A" if sequence1[position] != "A" else "C"
+        sequence1 = (sequence1[:position] + replacement +
+                     sequence1[position + 1:])
+    insert_size_metrics = InsertSizeMetrics()
+    insert_size_metrics.add_sequence_pair(sequence1, sequence2)
+    assert insert_size_metrics.insert_sizes()[insert_size] == 1
+
+
+def test_insert_size_metrics_repeated_adapters():
+    sequence1 = "GTACACGTTGCAGCTATCGA" + ILLUMINA_ADAPTER_R1
+    sequence2 = "TCGATAGCTGCAACGTGTAC" + ILLUMINA_ADAPTER_R2
+    other1 = "GTACACGTTGCAGCTATCGA" + "TTTTT" + ILLUMINA_ADAPTER_R1
+    other2 = "TCGATAGCTGCAACGTGTAC" + "GGGGG" + ILLUMINA_ADAPTER_R2
+    insert_size_metrics = InsertSizeMetrics()
+    for first, second in [(sequence1, sequence2), (sequence1, sequence2),
+                          (other1, other2), (sequence1, sequence2)]:
+        insert_size_metrics.add_sequence_pair(first, second)
+    assert insert_size_metrics.insert_sizes()[20] == 4
+    assert dict(insert_size_metrics.adapters_read1()) == {
+        ILLUMINA_ADAPTER_R1[:INSERT_SIZE_MAX_ADAPTER_STORE_SIZE]: 3,
+        ("TTTTT" + ILLUMINA_ADAPTER_R1)[:INSERT_SIZE_MAX_ADAPTER_STORE_SIZE]: 1,
+    }
+    assert dict(insert_size_metrics.adapters_read2()) == {
+        ILLUMINA_ADAPTER_R2[:INSERT_SIZE_MAX_ADAPTER_STORE_SIZE]: 3,
+        ("GGGGG" + ILLUMINA_ADAPTER_R2)[:INSERT_SIZE_MAX_ADAPTER_STORE_SIZE]: 1,
+    }
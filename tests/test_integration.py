@@ -15,11 +15,14 @@
 # along with Sequali.  If not, see <https://www.gnu.org/licenses/
 
 import json
+import os
+import subprocess
 import sys
 from pathlib import Path
 
 import pytest
 
+import sequali.__main__
 from sequali.__main__ import main
 
 TEST_DATA = Path(__file__).parent / "data"
@@ -123,6 +126,27 @@ def test_adapters_only(tmp_path):
         assert "Illumina" in d["best_match"]
 
 
+def test_adapters_only_sketch(tmp_path):
+    adapters_fastq = TEST_DATA / "100_illumina_adapters.fastq"
+    sys.argv = ["", "--dir", str(tmp_path),
+                "--overrepresentation-sample-every", "1",
+                "--overrepresentation-sketch-memory", "1",
+                str(adapters_fastq)]
+    main()
+    result = json.loads(
+        (tmp_path / "100_illumina_adapters.fastq.json").read_text())
+    overrepresented_sequences = result["overrepresented_sequences"]
+    assert overrepresented_sequences["sketch_memory"] == 1024 * 1024
+    assert overrepresented_sequences["total_fragments"] == 200
+    overrepr_seqs = overrepresented_sequences["overrepresented_sequences"]
+    assert overrepr_seqs
+    for d in overrepr_seqs:
+        assert d["count"] == 100
+        assert "Illumina" in d["best_match"]
+    html = (tmp_path / "100_illumina_adapters.fastq.html").read_text()
+    assert "count-min sketch" in html
+
+
 def test_nanopore_reads(tmp_path):
     # Nanopore reads from GM24385_1.fastq.gz from GIAB data.
     # https://github.com/genome-in-a-bottle/giab_data_indexes/blob/ade38024efc7f3db5be27ee270e4fb9537a97a1a/AshkenazimTrio/sequence.index.AJtrio_UCSC_ONT_UL_Promethion_03312019.HG002#L2
@@ -274,6 +298,162 @@ def test_paired_end_names_mismatching(tmp_path):
     error.match("D00360:76:C672MANXX:3:1101:5469:2124 2:N:0:1")
 
 
+def test_multiple_files_split_by_file(tmp_path):
+    simple_fastq = TEST_DATA / "simple.fastq"
+    single_nuc_fastq = TEST_DATA / "single_nuc.fastq"
+    sys.argv = ["", "--dir", str(tmp_path), "--split-by", "file",
+                f"{simple_fastq},{single_nuc_fastq}"]
+    main()
+    result = json.loads((tmp_path / "simple.fastq.json").read_text())
+    assert result["meta"]["filename"] == "simple.fastq, single_nuc.fastq"
+    assert result["summary"]["total_bases"] == 23
+    simple_result = json.loads(
+        (tmp_path / "simple.fastq.simple.fastq.json").read_text())
+    assert simple_result["meta"]["filename"] == "simple.fastq"
+    assert simple_result["summary"]["total_bases"] == 22
+    single_nuc_result = json.loads(
+        (tmp_path / "simple.fastq.single_nuc.fastq.json").read_text())
+    assert single_nuc_result["summary"]["total_bases"] == 1
+    assert (tmp_path / "simple.fastq.single_nuc.fastq.html").exists()
+
+
+def test_multiple_files_same_name_split_by_file(tmp_path):
+    simple_fastq = TEST_DATA / "simple.fastq"
+    sys.argv = ["", "--dir", str(tmp_path), "--split-by", "file",
+                f"{simple_fastq},{simple_fastq}"]
+    main()
+    result = json.loads((tmp_path / "simple.fastq.json").read_text())
+    assert result["summary"]["total_bases"] == 44
+    assert (tmp_path / "simple.fastq.simple.fastq.json").exists()
+    assert (tmp_path / "simple.fastq.simple.fastq_2.json").exists()
+
+
+def test_multiple_files_paired(tmp_path):
+    fastq1 = TEST_DATA / "LTB-A-BC001_S1_L003_R1_001.fastq.gz"
+    fastq2 = TEST_DATA / "LTB-A-BC001_S1_L003_R2_001.fastq.gz"
+    sys.argv = ["", "--dir", str(tmp_path), f"{fastq1},{fastq1}",
+                f"{fastq2},{fastq2}"]
+    main()
+    result = json.loads(
+        (tmp_path / "LTB-A-BC001_S1_L003_R1_001.fastq.gz.json").read_text())
+    single_sys_argv = ["", "--dir", str(tmp_path / "single"), str(fastq1),
+                       str(fastq2)]
+    sys.argv = single_sys_argv
+    main()
+    single_result = json.loads(
+        (tmp_path / "single" / "LTB-A-BC001_S1_L003_R1_001.fastq.gz.json"
+         ).read_text())
+    assert (result["summary"]["total_reads"] ==
+            2 * single_result["summary"]["total_reads"])
+    assert (result["summary_read2"]["total_reads"] ==
+            2 * single_result["summary_read2"]["total_reads"])
+
+
+def test_multiple_files_paired_mismatching_number(tmp_path):
+    fastq1 = TEST_DATA / "LTB-A-BC001_S1_L003_R1_001.fastq.gz"
+    fastq2 = TEST_DATA / "LTB-A-BC001_S1_L003_R2_001.fastq.gz"
+    sys.argv = ["", "--dir", str(tmp_path), f"{fastq1},{fastq1}",
+                str(fastq2)]
+    with pytest.raises(ValueError) as error:
+        main()
+    error.match("2 files for read 1 and 1 files for read 2")
+
+
+def test_multiple_files_mismatching_sequencing_technologies(tmp_path):
+    fastq1 = TEST_DATA / "simple.fastq"
+    fastq2 = TEST_DATA / "100_nanopore_reads.fastq.gz"
+    sys.argv = ["", "--dir", str(tmp_path), f"{fastq1},{fastq2}"]
+    with pytest.raises(RuntimeError) as error:
+        main()
+    error.match("Mismatching sequencing technologies")
+    error.match("nanopore")
+
+
+def test_split_by_read_group(tmp_path):
+    bam = TEST_DATA / "simple.unaligned.bam"
+    sys.argv = ["", "--dir", str(tmp_path), "--split-by", "read-group",
+                str(bam)]
+    main()
+    result = json.loads((tmp_path / "simple.unaligned.bam.json").read_text())
+    group_result = json.loads(
+        (tmp_path / "simple.unaligned.bam.A.json").read_text())
+    assert result["meta"]["read_group"] is None
+    assert group_result["meta"]["read_group"] == "A"
+    assert group_result["summary"] == result["summary"]
+
+
+def test_split_by_read_group_serial(tmp_path, monkeypatch):
+    # Read groups are run without a pipeline, so many read groups do not
+    # start threads and module copies for each group.
+    pipelines = []
+    qc_pipeline = sequali.__main__.QCPipeline
+
+    def counting_pipeline(*args, **kwargs):
+        pipelines.append(args)
+        return qc_pipeline(*args, **kwargs)
+
+    monkeypatch.setattr(sequali.__main__, "QCPipeline", counting_pipeline)
+    bam = TEST_DATA / "simple.unaligned.bam"
+    sys.argv = ["", "--dir", str(tmp_path), "--split-by", "read-group",
+                "--threads", "4", str(bam)]
+    main()
+    assert pipelines == []
+    assert (tmp_path / "simple.unaligned.bam.A.json").exists()
+
+
+def test_split_by_read_group_fastq(tmp_path):
+    sys.argv = ["", "--dir", str(tmp_path), "--split-by", "read-group",
+                str(TEST_DATA / "simple.fastq")]
+    with pytest.raises(RuntimeError) as error:
+        main()
+    error.match("only supported for BAM")
+
+
+def test_stdin(tmp_path, monkeypatch):
+    with open(TEST_DATA / "simple.fastq", "rb") as stdin:
+        monkeypatch.setattr(sys, "stdin", stdin)
+        sys.argv = ["", "--dir", str(tmp_path), "-"]
+        main()
+    result = json.loads((tmp_path / "stdin.json").read_text())
+    assert result["summary"]["total_bases"] == 22
+
+
+def test_snapshot(tmp_path):
+    fastq = TEST_DATA / "100_nanopore_reads.fastq.gz"
+    snapshot = tmp_path / "snapshot.json"
+    sys.argv = ["", "--dir", str(tmp_path), "--snapshot", "snapshot.json",
+                "--snapshot-every-reads", "10", str(fastq)]
+    main()
+    result = json.loads(snapshot.read_text())
+    report = json.loads(
+        (tmp_path / "100_nanopore_reads.fastq.gz.json").read_text())
+    assert result["finished"] is True
+    assert result["meta"]["filename"] == "100_nanopore_reads.fastq.gz"
+    assert result["summary"] == report["summary"]
+    assert not (tmp_path / "snapshot.json.tmp").exists()
+
+
+def test_snapshot_paired(tmp_path):
+    fastq1 = TEST_DATA / "LTB-A-BC001_S1_L003_R1_001.fastq.gz"
+    fastq2 = TEST_DATA / "LTB-A-BC001_S1_L003_R2_001.fastq.gz"
+    snapshot = tmp_path / "snapshot.json"
+    sys.argv = ["", "--dir", str(tmp_path), "--no-report",
+                "--snapshot", str(snapshot), str(fastq1), str(fastq2)]
+    main()
+    result = json.loads(snapshot.read_text())
+    assert result["summary"]["total_reads"] == \
+        result["summary_read2"]["total_reads"]
+    assert result["summary_read2"]["read_pair_info"] == "Read 2"
+
+
+def test_snapshot_split_by(tmp_path):
+    sys.argv = ["", "--dir", str(tmp_path), "--snapshot", "snapshot.json",
+                "--split-by", "file", str(TEST_DATA / "simple.fastq")]
+    with pytest.raises(ValueError) as error:
+        main()
+    error.match("split-by")
+
+
 def test_version_command(capsys):
     sys.argv = ["", "--version"]
     with pytest.raises(SystemExit):
@@ -281,3 +461,52 @@ def test_version_command(capsys):
     result = capsys.readouterr()
     import sequali
     assert result.out.replace("\n", "") == sequali.__version__
+
+
+def test_profile(tmp_path):
+    fastq1 = TEST_DATA / "LTB-A-BC001_S1_L003_R1_001.fastq.gz"
+    fastq2 = TEST_DATA / "LTB-A-BC001_S1_L003_R2_001.fastq.gz"
+    sys.argv = ["", "--dir", str(tmp_path), "--profile",
+                str(fastq1), str(fastq2)]
+    main()
+    result = json.loads(
+        (tmp_path / "LTB-A-BC001_S1_L003_R1_001.fastq.gz.json").read_text())
+    profile = result["profile"]
+    assert profile["reads"] == 2 * result["summary"]["total_reads"]
+    assert "QCMetrics read 2" in profile["module_times"]
+    assert "DedupEstimator" in profile["hash_tables"]
+    assert "Profile" in (
+        tmp_path / "LTB-A-BC001_S1_L003_R1_001.fastq.gz.html").read_text()
+
+
+@pytest.mark.parametrize("filename", ["100_nanopore_reads.fastq.gz",
+                                      "dorado_nanopore_100reads.bam"])
+def test_simd_default_same_as_dispatched(tmp_path, filename):
+    # The dispatch is chosen when the module is loaded, so the default code
+    # paths are run in a new process.
+    input_file = TEST_DATA / filename
+    sys.argv = ["", "--dir", str(tmp_path / "dispatched"), str(input_file)]
+    main()
+    subprocess.run(
+        [sys.executable, "-m", "sequali", "--dir", str(tmp_path / "default"),
+         str(input_file)],
+        env=dict(os.environ, SEQUALI_SIMD="default"), check=True)
+    dispatched = json.loads(
+        (tmp_path / "dispatched" / f"{filename}.json").read_text())
+    default = json.loads(
+        (tmp_path / "default" / f"{filename}.json").read_text())
+    dispatched.pop("meta")
+    default.pop("meta")
+    assert dispatched == default
+
+
+def test_simd_unknown_variant():
+    # A typo must not silently run the dispatched code paths.
+    for module in ("sequali._qc", "sequali._seqident"):
+        process = subprocess.run(
+            [sys.executable, "-c", f"import {module}"],
+            env=dict(os.environ, SEQUALI_SIMD="sse3"),
+            stderr=subprocess.PIPE)
+        assert process.returncode != 0
+        assert b"SEQUALI_SIMD" in process.stderr
+        assert b"sse3" in process.stderr
@@ -15,8 +15,11 @@
 # along with Sequali.  If not, see <https://www.gnu.org/licenses/
 
 import datetime
+import math
 import struct
 
+import pytest
+
 from sequali import FastqRecordView
 from sequali._qc import NanoStats
 
@@ -95,3 +98,155 @@ def test_nano_stats_from_tags():
     assert info.cumulative_error_rate == cumulative_error_rate
     assert info.duration == duration
     assert info.parent_id_hash == parent_id_hash
+
+
+def test_nano_stats_merge():
+    views = [
+        FastqRecordView("cb1dab45-aa4c-43fc-a91e-ad0ecc92f5c9 "
+                        f"ch={channel} start_time=2021-09-30T11:34:0{channel}Z",
+                        "ACGT", "AAAA")
+        for channel in range(1, 4)
+    ]
+    first = NanoStats()
+    first.add_read(views[1])
+    second = NanoStats()
+    second.add_read(views[0])
+    second.add_read(views[2])
+    first.merge(second)
+    assert first.number_of_reads == 3
+    channels = [info.channel_id for info in first.nano_info_iterator()]
+    assert channels == [2, 1, 3]
+    assert first.maximum_time - first.minimum_time == 2
+
+
+def test_nano_stats_merge_skipped():
+    nanostats = NanoStats()
+    skipped = NanoStats()
+    skipped.add_read(FastqRecordView("not_a_nanopore_read", "ACGT", "AAAA"))
+    nanostats.merge(skipped)
+    assert nanostats.skipped_reason == skipped.skipped_reason
+
+
+def nanopore_view(channel, start_time, sequence="ACGT", qualities="AAAA"):
+    return FastqRecordView(
+        f"cb1dab45-aa4c-43fc-a91e-ad0ecc92f5c9 ch={channel} "
+        f"start_time={start_time}Z",
+        sequence, qualities)
+
+
+def test_nano_stats_aggregates():
+    nanostats = NanoStats()
+    nanostats.add_read(nanopore_view(1, "2021-09-30T11:34:08"))
+    nanostats.add_read(nanopore_view(2, "2021-09-30T11:34:59", "ACGTACGT",
+                                     "++++++++"))
+    nanostats.add_read(nanopore_view(2, "2021-09-30T11:36:00"))
+    assert nanostats.minutes_per_time_bin == 1
+    slots = nanostats.time_slot_statistics(60)
+    assert len(slots) == 3
+    bases, reads, active_channels, quals = slots[0]
+    assert bases == 12
+    assert reads == 2
+    assert active_channels == 2
+    # Phred 32 and phred 10, binned per 4.
+    assert quals[8] == 1
+    assert quals[2] == 1
+    assert sum(quals) == 2
+    assert slots[1] == (0, 0, 0, (0,) * 12)
+    assert slots[2][:3] == (4, 1, 1)
+    assert nanostats.time_slot_statistics(180) == [
+        (16, 3, 2, (0, 0, 1, 0, 0, 0, 0, 0, 2, 0, 0, 0))]
+    channels = nanostats.channel_statistics()
+    assert [(channel, bases) for channel, bases, _ in channels] == [
+        (1, 4), (2, 12)]
+    assert math.isclose(channels[1][2], 4 * 10 ** -3.2 + 8 * 10 ** -1)
+    assert sum(nanostats.translocation_speeds()) == 0
+
+
+def test_nano_stats_time_slot_statistics_wrong_size():
+    nanostats = NanoStats()
+    nanostats.add_read(nanopore_view(1, "2021-09-30T11:34:08"))
+    with pytest.raises(ValueError) as error:
+        nanostats.time_slot_statistics(90)
+    error.match("multiple of 60")
+
+
+def test_nano_stats_sample_limit():
+    nanostats = NanoStats(max_sampled_reads=10)
+    for i in range(100):
+        nanostats.add_read(nanopore_view(i, "2021-09-30T11:34:08"))
+    assert nanostats.number_of_reads == 100
+    assert nanostats.number_of_sampled_reads == 10
+    channels = [info.channel_id for info in nanostats.nano_info_iterator()]
+    assert len(channels) == 10
+    assert len(set(channels)) == 10
+    assert len(nanostats.channel_statistics()) == 100
+    assert nanostats.time_slot_statistics(60)[0][:3] == (400, 100, 100)
+
+
+def test_nano_stats_merge_aggregates():
+    first = NanoStats(max_sampled_reads=5)
+    second = NanoStats(max_sampled_reads=5)
+    for i in range(10):
+        first.add_read(nanopore_view(i, "2021-09-30T11:34:08"))
+        second.add_read(nanopore_view(i + 10, "2021-09-30T13:34:08"))
+    first.merge(second)
+    assert first.number_of_reads == 20
+    assert first.number_of_sampled_reads == 5
+    assert len(first.channel_statistics()) == 20
+    slots = first.time_slot_statistics(60)
+    assert len(slots) == 121
+    assert slots[0][:3] == (40, 10, 10)
+    assert slots[-1][:3] == (40, 10, 10)
+
+
+def test_nano_stats_dump_load():
+    nanostats = NanoStats(max_sampled_reads=5)
+    for i in range(10):
+        nanostats.add_read(nanopore_view(i, "2021-09-30T11:34:08"))
+        nanostats.add_read(nanopore_view(i + 10, "2021-09-30T13:34:08",
+                                         "ACGTACGT", "AAAAAAAA"))
+    loaded = NanoStats.load(nanostats.dump())
+    assert loaded.number_of_reads == nanostats.number_of_reads
+    assert loaded.max_sampled_reads == nanostats.max_sampled_reads
+    assert loaded.minimum_time == nanostats.minimum_time
+    assert loaded.maximum_time == nanostats.maximum_time
+    assert loaded.minutes_per_time_bin == nanostats.minutes_per_time_bin
+    assert loaded.time_slot_statistics(60) == \
+        nanostats.time_slot_statistics(60)
+    assert loaded.channel_statistics() == nanostats.channel_statistics()
+    assert loaded.translocation_speeds() == nanostats.translocation_speeds()
+    info_fields = ("start_time", "channel_id", "length",
+                   "cumulative_error_rate", "duration", "parent_id_hash")
+    assert [[getattr(info, field) for field in info_fields]
+            for info in loaded.nano_info_iterator()] == \
+        [[getattr(info, field) for field in info_fields]
+         for info in nanostats.nano_info_iterator()]
+    loaded.add_read(nanopore_view(5, "2021-09-30T12:34:08"))
+    assert loaded.number_of_reads == nanostats.number_of_reads + 1
+
+
+def test_nano_stats_dump_load_skipped():
+    skipped = NanoStats()
+    skipped.add_read(FastqRecordView("not_a_nanopore_read", "ACGT", "AAAA"))
+    loaded = NanoStats.load(skipped.dump())
+    assert loaded.skipped_reason == skipped.skipped_reason
+
+
+def test_nano_stats_widely_separated_times():
+    nanostats = NanoStats()
+    nanostats.add_read(nanopore_view(1, "2021-09-30T11:34:08"))
+    nanostats.add_read(nanopore_view(2, "2022-09-30T11:34:08"))
+    # A year does not fit in 8192 bins of one minute, so bins are merged.
+    assert nanostats.minutes_per_time_bin > 1
+    slots = nanostats.time_slot_statistics(
+        nanostats.minutes_per_time_bin * 60)
+    assert slots[0][:3] == (4, 1, 1)
+    assert slots[-1][:3] == (4, 1, 1)
+    assert sum(slot[1] for slot in slots) == 2
+
+
+def test_nano_stats_channel_out_of_range():
+    nanostats = NanoStats()
+    nanostats.add_read(nanopore_view(70000, "2021-09-30T11:34:08"))
+    assert nanostats.skipped_reason is not None
+    assert "70000" in nanostats.skipped_reason
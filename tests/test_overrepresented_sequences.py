@@ -15,11 +15,17 @@
 # along with Sequali.  If not, see <https://www.gnu.org/licenses/
 import itertools
 import math
+import random
+import struct
+import sys
 import warnings
 
 import pytest
 
 from sequali import FastqRecordView, OverrepresentedSequences
+from sequali.sequence_identification import reverse_complement
+
+from .merge_helpers import check_merge
 
 
 def view_from_sequence(sequence: str) -> FastqRecordView:
@@ -159,6 +165,18 @@ def test_overrepresented_sequences_all_fragments(sequence, result):
     assert seq_counts == result
 
 
+@pytest.mark.parametrize("repeats", [1, 10, 100, 1000])
+def test_overrepresented_sequences_long_read_duplicate_fragments(repeats):
+    # Long reads with many fragments take the hash table path for removing
+    # duplicate fragments. Duplicates should only be counted once per read.
+    seqs = OverrepresentedSequences(fragment_length=7, sample_every=1,
+                                    bases_from_start=-1, bases_from_end=-1)
+    sequence = "GATTACA" + "CCCTTTG" * repeats + "GATTACA"
+    for _ in range(3):
+        seqs.add_read(view_from_sequence(sequence))
+    assert seqs.sequence_counts() == {"GATTACA": 3, "CAAAGGG": 3}
+
+
 def test_very_short_sequence():
     # With 32 byte load this will overflow the used memory.
     seqs = OverrepresentedSequences(fragment_length=3, sample_every=1)
@@ -206,3 +224,192 @@ def test_overrepresented_sequences_sample_from_begin_and_end(
     overrepresented = [x[2] for x in seqs.overrepresented_sequences(min_threshold=1)]
     overrepresented.sort()
     assert tuple(overrepresented) == result
+
+
+def test_overrepresented_sequences_merge():
+    sequences = ["AACCGGTTTTGGCCAA", "GATTACAGATTACA", "AACCGGTTTTGGCCAA"]
+    check_merge(
+        lambda: OverrepresentedSequences(fragment_length=3, sample_every=1),
+        OverrepresentedSequences.add_read,
+        [view_from_sequence(sequence) for sequence in sequences],
+        lambda seqs: (seqs.number_of_sequences, seqs.sampled_sequences,
+                      seqs.total_fragments, seqs.sequence_counts()))
+
+
+def test_overrepresented_sequences_dump_load():
+    overrep = OverrepresentedSequences(fragment_length=3, sample_every=1,
+                                       bases_from_start=9, bases_from_end=-1)
+    for sequence in ["AACCGGTTTTGGCCAA", "GATTACAGATTACA", "AACCGGTTTTGGCCAA"]:
+        overrep.add_read(view_from_sequence(sequence))
+    loaded = OverrepresentedSequences.load(overrep.dump())
+    assert loaded.fragment_length == overrep.fragment_length
+    assert loaded.max_unique_fragments == overrep.max_unique_fragments
+    assert loaded.number_of_sequences == overrep.number_of_sequences
+    assert loaded.sampled_sequences == overrep.sampled_sequences
+    assert loaded.total_fragments == overrep.total_fragments
+    assert loaded.sequence_counts() == overrep.sequence_counts()
+    loaded.merge(overrep)
+
+
+def test_overrepresented_sequences_merge_self():
+    overrep = OverrepresentedSequences(fragment_length=3, sample_every=1)
+    overrep.add_read(view_from_sequence("AACCGGTTTTGGCCAA"))
+    counts = overrep.sequence_counts()
+    with pytest.raises(ValueError) as error:
+        overrep.merge(overrep)
+    error.match("itself")
+    assert overrep.sequence_counts() == counts
+    assert overrep.number_of_sequences == 1
+
+
+def test_overrepresented_sequences_merge_different_fragment_length():
+    seqs = OverrepresentedSequences(fragment_length=3)
+    with pytest.raises(ValueError) as error:
+        seqs.merge(OverrepresentedSequences(fragment_length=5))
+    error.match("fragment_length")
+
+
+def test_overrepresented_sequences_hash_table_stats():
+    overrep = OverrepresentedSequences(fragment_length=3, sample_every=1,
+                                       max_unique_fragments=100)
+    for sequence in ["AACCGGTTTTGGCCAA", "GATTACAGATTACA", "AACCGGTTTTGGCCAA"]:
+        overrep.add_read(view_from_sequence(sequence))
+    stats = overrep.hash_table_stats()
+    assert stats["used"] == len(overrep.sequence_counts())
+    assert stats["size"] >= stats["used"]
+    assert math.isclose(stats["load_factor"], stats["used"] / stats["size"])
+    assert 0.0 <= stats["mean_probe_length"] <= stats["max_probe_length"]
+
+
+def random_sequence(rng: random.Random, length: int) -> str:
+    return "".join(rng.choices("ACGT", k=length))
+
+
+def test_overrepresented_sequences_sketch_no_start_of_file_bias():
+    # Unique fragments at the start of the file fill the exact table, so a
+    # fragment that becomes common later is only found by the sketch.
+    rng = random.Random(42)
+    exact = OverrepresentedSequences(max_unique_fragments=1000,
+                                     fragment_length=21, sample_every=1)
+    sketch = OverrepresentedSequences(max_unique_fragments=1000,
+                                      fragment_length=21, sample_every=1,
+                                      sketch_memory=256 * 1024)
+    late_sequence = random_sequence(rng, 21)
+    sequences = [random_sequence(rng, 21) for _ in range(5000)]
+    sequences += [late_sequence] * 100
+    for sequence in sequences:
+        exact.add_read(view_from_sequence(sequence))
+        sketch.add_read(view_from_sequence(sequence))
+    assert exact.collected_unique_fragments == 1000
+    assert sketch.collected_unique_fragments == sketch.max_heavy_hitters
+    canonical = min(late_sequence, reverse_complement(late_sequence))
+    assert canonical not in exact.sequence_counts()
+    count, fraction, sequence = sketch.overrepresented_sequences(
+        threshold_fraction=0.01)[0]
+    assert sequence == canonical
+    # Count-min sketch estimates never undercount.
+    assert count >= 100
+
+
+def test_overrepresented_sequences_sketch_same_as_exact():
+    rng = random.Random(3)
+    common = [random_sequence(rng, 31) for _ in range(20)]
+    exact = OverrepresentedSequences(fragment_length=31, sample_every=1)
+    sketch = OverrepresentedSequences(fragment_length=31, sample_every=1,
+                                      sketch_memory=1024 * 1024)
+    for i in range(3000):
+        sequence = common[i % 20] if i % 3 == 0 else random_sequence(rng, 31)
+        exact.add_read(view_from_sequence(sequence))
+        sketch.add_read(view_from_sequence(sequence))
+    assert sketch.sampled_sequences == exact.sampled_sequences
+    assert sketch.total_fragments == exact.total_fragments
+    # With a wide sketch and room for all fragments the counts are exact.
+    assert sketch.sequence_counts() == exact.sequence_counts()
+    assert (sketch.overrepresented_sequences(threshold_fraction=0.01) ==
+            exact.overrepresented_sequences(threshold_fraction=0.01))
+    stats = sketch.hash_table_stats()
+    assert stats["used"] == sketch.collected_unique_fragments
+
+
+def test_overrepresented_sequences_sketch_merge_dump_load():
+    rng = random.Random(5)
+    common = random_sequence(rng, 21)
+    sequences = [common if i % 10 == 0 else random_sequence(rng, 21)
+                 for i in range(4000)]
+    # The sketches add up, so both estimate the same counts.
+    first = check_merge(
+        lambda: OverrepresentedSequences(
+            max_unique_fragments=500, fragment_length=21, sample_every=1,
+            sketch_memory=64 * 1024),
+        OverrepresentedSequences.add_read,
+        [view_from_sequence(sequence) for sequence in sequences],
+        lambda seqs: seqs.overrepresented_sequences(threshold_fraction=0.05),
+        split=2000)
+    loaded = OverrepresentedSequences.load(first.dump())
+    assert loaded.sketch_memory == first.sketch_memory
+    assert loaded.sequence_counts() == first.sequence_counts()
+    loaded.add_read(view_from_sequence(common))
+    first.add_read(view_from_sequence(common))
+    assert loaded.sequence_counts() == first.sequence_counts()
+
+
+def test_overrepresented_sequences_max_unique_fragments_too_large():
+    with pytest.raises(ValueError) as error:
+        OverrepresentedSequences(max_unique_fragments=sys.maxsize)
+    error.match("max_unique_fragments")
+
+
+def test_overrepresented_sequences_load_truncated_or_mutated():
+    # Every truncated state is an error. A mutated state either loads into a
+    # usable object or is an error, but never crashes or hangs.
+    overrep = OverrepresentedSequences(max_unique_fragments=100,
+                                       fragment_length=3, sample_every=1)
+    for sequence in ["AACCGGTTTTGGCCAA", "GATTACAGATTACA", "AACCGGTTTTGGCCAA"]:
+        overrep.add_read(view_from_sequence(sequence))
+    state = overrep.dump()
+    for end in range(len(state)):
+        with pytest.raises(ValueError):
+            OverrepresentedSequences.load(state[:end])
+    for i in range(len(state)):
+        for flip in (0x01, 0x80, 0xFF):
+            mutated = state[:i] + bytes([state[i] ^ flip]) + state[i + 1:]
+            try:
+                loaded = OverrepresentedSequences.load(mutated)
+            except ValueError:
+                continue
+            loaded.add_read(view_from_sequence("GATTACAGATTACA"))
+            loaded.sequence_counts()
+            OverrepresentedSequences.load(loaded.dump())
+
+
+def test_overrepresented_sequences_sketch_load_huge_memory():
+    # The dumped counters are checked before the sketch is allocated, so a
+    # corrupt sketch_memory is an error rather than a huge allocation.
+    sketch = OverrepresentedSequences(fragment_length=21, sample_every=1,
+                                      sketch_memory=64 * 1024)
+    sketch.add_read(view_from_sequence("GATTACA" * 3))
+    state = sketch.dump()
+    # sketch_memory follows the name and five other settings.
+    name = b"OverrepresentedSequences"
+    offset = state.index(name) + len(name) + 5 * 8
+    assert state[offset:offset + 8] == struct.pack("=Q", 64 * 1024)
+    state = state[:offset] + struct.pack("=Q", 1 << 50) + state[offset + 8:]
+    with pytest.raises(ValueError) as error:
+        OverrepresentedSequences.load(state)
+    error.match("truncated")
+
+
+def test_overrepresented_sequences_sketch_merge_different_memory():
+    sketch = OverrepresentedSequences(sketch_memory=64 * 1024)
+    with pytest.raises(ValueError) as error:
+        sketch.merge(OverrepresentedSequences(sketch_memory=128 * 1024))
+    error.match("sketch_memory")
+    with pytest.raises(ValueError) as error:
+        sketch.merge(OverrepresentedSequences(max_unique_fragments=100))
+    error.match("sketch_memory")
+
+
+def test_overrepresented_sequences_sketch_memory_too_small():
+    with pytest.raises(ValueError) as error:
+        OverrepresentedSequences(sketch_memory=1000)
+    error.match("sketch_memory")
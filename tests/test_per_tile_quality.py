@@ -14,10 +14,14 @@
 # You should have received a copy of the GNU Affero General Public License
 # along with Sequali.  If not, see <https://www.gnu.org/licenses/
 
+import math
+
 import pytest
 
 from sequali import FastqRecordView, PerTileQuality
 
+from .merge_helpers import check_merge
+
 
 def test_per_tile_quality():
     read = FastqRecordView(
@@ -83,3 +87,81 @@ def test_per_tile_quality_skip(header):
     assert ptq.number_of_reads == 0
     assert ptq.max_length == 0
     assert header in ptq.skipped_reason
+
+
+def test_per_tile_quality_merge():
+    reads = [
+        FastqRecordView("SIM:1:FCX:1:15:6329:1045 1:N:0:ATCCGA", "AAAA", "ABCD"),
+        FastqRecordView("SIM:1:FCX:1:15:6329:1046 1:N:0:ATCCGA", "AAAAAA",
+                        "ABCDEF"),
+        FastqRecordView("SIM:1:FCX:1:21:6329:1047 1:N:0:ATCCGA", "AA", "AB"),
+    ]
+    check_merge(
+        PerTileQuality,
+        PerTileQuality.add_read,
+        reads,
+        lambda ptq: (ptq.number_of_reads, ptq.max_length,
+                     ptq.get_tile_counts()))
+
+
+def test_per_tile_quality_merge_skipped():
+    ptq = PerTileQuality()
+    ptq.add_read(FastqRecordView("SIM:1:FCX:1:15:6329:1045", "AAAA", "ABCD"))
+    skipped = PerTileQuality()
+    skipped.add_read(FastqRecordView("SIMULATED_NAME", "AAAA", "ABCD"))
+    ptq.merge(skipped)
+    assert ptq.skipped_reason == skipped.skipped_reason
+
+
+def test_per_tile_quality_dump_load():
+    ptq = PerTileQuality()
+    for i, tile in enumerate([1, 15, 1, 150]):
+        ptq.add_read(FastqRecordView(
+            f"SIM:1:FCX:1:{tile}:6329:{i} 1:N:0:ATCCGA", "A" * (i + 1),
+            chr(33 + i) * (i + 1)))
+    loaded = PerTileQuality.load(ptq.dump())
+    assert loaded.number_of_reads == ptq.number_of_reads
+    assert loaded.max_length == ptq.max_length
+    assert loaded.get_tile_counts() == ptq.get_tile_counts()
+
+
+def test_per_tile_quality_dump_load_skipped():
+    skipped = PerTileQuality()
+    skipped.add_read(FastqRecordView("SIMULATED_NAME", "AAAA", "ABCD"))
+    loaded = PerTileQuality.load(skipped.dump())
+    assert loaded.skipped_reason == skipped.skipped_reason
+
+
+def test_per_tile_quality_interleaved_tiles():
+    tiles = [1, 15, 1, 1, 150, 15, 2, 1]
+    ptq = PerTileQuality()
+    for i, tile in enumerate(tiles):
+        ptq.add_read(FastqRecordView(
+            f"SIM:1:FCX:1:{tile}:6329:{i} 1:N:0:ATCCGA", "A" * (i + 1),
+            "I" * (i + 1)))
+    assert ptq.max_length == len(tiles)
+    counts = ptq.get_tile_counts()
+    assert [tile for tile, _, _ in counts] == [1, 2, 15, 150]
+    count_lists = {tile: count_list for tile, _, count_list in counts}
+    assert count_lists[1] == [4, 3, 3, 2, 1, 1, 1, 1]
+    assert count_lists[2] == [1, 1, 1, 1, 1, 1, 1, 0]
+    assert count_lists[15] == [2, 2, 1, 1, 1, 1, 0, 0]
+    assert count_lists[150] == [1, 1, 1, 1, 1, 0, 0, 0]
+
+
+def test_per_tile_quality_get_tile_counts_ranges():
+    ptq = PerTileQuality()
+    for i, tile in enumerate([1, 15, 1, 150, 15]):
+        ptq.add_read(FastqRecordView(
+            f"SIM:1:FCX:1:{tile}:6329:{i} 1:N:0:ATCCGA", "A" * (i + 2),
+            chr(35 + 5 * i) * (i + 2)))
+    ranges = [(0, 2), (2, 3), (3, 100)]
+    full = ptq.get_tile_counts()
+    ranged = ptq.get_tile_counts(ranges=ranges)
+    assert [tile for tile, _, _ in ranged] == [tile for tile, _, _ in full]
+    for (_, errors, counts), (_, range_errors, range_counts) in zip(
+            full, ranged):
+        assert range_counts == [sum(counts[start:stop])
+                                for start, stop in ranges]
+        for range_error, (start, stop) in zip(range_errors, ranges):
+            assert math.isclose(range_error, sum(errors[start:stop]))
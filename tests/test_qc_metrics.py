@@ -16,10 +16,14 @@
 
 import math
 
+import pytest
+
 from sequali import A, C, G, N, T
-from sequali import FastqRecordView, QCMetrics
+from sequali import FastqRecordView, PerTileQuality, QCMetrics
 from sequali import NUMBER_OF_NUCS, NUMBER_OF_PHREDS
 
+from .merge_helpers import check_merge
+
 
 def view_from_sequence(sequence: str) -> FastqRecordView:
     return FastqRecordView(
@@ -105,3 +109,172 @@ def test_average_long_quality():
     phred = -10 * math.log10(error_rate)
     metrics.add_read(FastqRecordView("name", sequence, qualities))
     assert metrics.phred_scores()[math.floor(phred)] == 1
+
+
+def test_qc_metrics_merge():
+    reads = [
+        FastqRecordView("name", "ACGTN" * 4, chr(10 + 33) * 20),
+        FastqRecordView("name", "GGCC" * 30, chr(30 + 33) * 120),
+        FastqRecordView("name", "AT", chr(20 + 33) * 2),
+    ]
+    check_merge(
+        QCMetrics,
+        QCMetrics.add_read,
+        reads,
+        lambda metrics: (metrics.number_of_reads, metrics.max_length,
+                         metrics.base_count_table(),
+                         metrics.phred_count_table(),
+                         metrics.gc_content(), metrics.phred_scores()))
+
+
+def test_qc_metrics_merge_wrong_type():
+    metrics = QCMetrics()
+    with pytest.raises(TypeError) as error:
+        metrics.merge("QCMetrics")  # type: ignore
+    error.match("QCMetrics")
+    error.match("str")
+
+
+def test_qc_metrics_dump_load():
+    metrics = QCMetrics()
+    metrics.add_read(FastqRecordView("name", "ACGTN" * 4, chr(10 + 33) * 20))
+    metrics.add_read(FastqRecordView("name", "GGCC" * 30, chr(30 + 33) * 120))
+    loaded = QCMetrics.load(metrics.dump())
+    assert loaded.number_of_reads == metrics.number_of_reads
+    assert loaded.max_length == metrics.max_length
+    assert loaded.base_count_table() == metrics.base_count_table()
+    assert loaded.phred_count_table() == metrics.phred_count_table()
+    assert loaded.gc_content() == metrics.gc_content()
+    assert loaded.phred_scores() == metrics.phred_scores()
+    # The loaded object can be updated and merged.
+    loaded.add_read(FastqRecordView("name", "AT", chr(20 + 33) * 2))
+    loaded.merge(metrics)
+    assert loaded.number_of_reads == 5
+
+
+def test_qc_metrics_load_empty():
+    loaded = QCMetrics.load(QCMetrics().dump())
+    assert loaded.number_of_reads == 0
+    assert loaded.max_length == 0
+
+
+@pytest.mark.parametrize(["change", "message"], [
+    (lambda state: state[:-1], "truncated"),
+    (lambda state: state + b"\0", "trailing data"),
+    (lambda state: b"NOTSTATE" + state[8:], "not a dumped state"),
+    (lambda state: state[:8] + b"\xff" + state[9:], "version"),
+    (lambda state: state[:12] + b"\0" + state[13:], "byte order"),
+    (lambda state: state[:10], "truncated"),
+])
+def test_qc_metrics_load_invalid(change, message):
+    metrics = QCMetrics()
+    metrics.add_read(FastqRecordView("name", "ACGT", "IIII"))
+    with pytest.raises(ValueError) as error:
+        QCMetrics.load(change(metrics.dump()))
+    error.match(message)
+
+
+def test_qc_metrics_load_wrong_module():
+    with pytest.raises(ValueError) as error:
+        QCMetrics.load(PerTileQuality().dump())
+    error.match("PerTileQuality")
+    with pytest.raises(TypeError) as error:
+        QCMetrics.load("QCMetrics")  # type: ignore
+    error.match("bytes")
+
+
+def test_qc_metrics_all_lengths():
+    # Check the vectorized code paths and their remainders against
+    # straightforward counting. The reads grow in length, so the tables are
+    # resized while they hold counts.
+    metrics = QCMetrics()
+    nucleotides = "ACGTNacgtnX"
+    nuc_index = dict(A=A, C=C, G=G, T=T, a=A, c=C, g=G, t=T)
+    max_length = 200
+    base_counts = [0] * (max_length * NUMBER_OF_NUCS)
+    phred_counts = [0] * (max_length * NUMBER_OF_PHREDS)
+    for length in range(1, max_length + 1):
+        sequence = "G" + "".join(
+            nucleotides[(i * 7 + length) % len(nucleotides)]
+            for i in range(length - 1))
+        qualities = "".join(chr(((i * 13 + length) % 94) + 33)
+                            for i in range(length))
+        metrics.add_read(FastqRecordView("name", sequence, qualities))
+        for i, (nuc, qual) in enumerate(zip(sequence, qualities)):
+            base_counts[i * NUMBER_OF_NUCS + nuc_index.get(nuc, N)] += 1
+            phred_index = min(ord(qual) - 33, 47) // 4
+            phred_counts[i * NUMBER_OF_PHREDS + phred_index] += 1
+    assert list(metrics.base_count_table()) == base_counts
+    assert list(metrics.phred_count_table()) == phred_counts
+
+
+@pytest.mark.parametrize("position", [0, 31, 32, 33, 63, 64, 99])
+def test_qc_metrics_invalid_phred(position):
+    metrics = QCMetrics()
+    qualities = ["I"] * 100
+    qualities[position] = " "
+    with pytest.raises(ValueError) as error:
+        metrics.add_read(FastqRecordView("name", "A" * 100,
+                                         "".join(qualities)))
+    error.match("phred")
+
+
+def test_qc_metrics_flush_after_short_reads():
+    # The staging tables are flushed every 65535 reads. Only the positions
+    # used since the previous flush are flushed.
+    metrics = QCMetrics()
+    metrics.add_read(view_from_sequence("C" * 100))
+    for _ in range(70_000):
+        metrics.add_read(view_from_sequence("G" * 10))
+    metrics.add_read(view_from_sequence("T" * 50))
+    base_array = metrics.base_count_table()
+    for i in range(10):
+        assert base_array[C + NUMBER_OF_NUCS * i] == 1
+        assert base_array[G + NUMBER_OF_NUCS * i] == 70_000
+        assert base_array[T + NUMBER_OF_NUCS * i] == 1
+    for i in range(10, 50):
+        assert base_array[C + NUMBER_OF_NUCS * i] == 1
+        assert base_array[T + NUMBER_OF_NUCS * i] == 1
+    for i in range(50, 100):
+        assert base_array[C + NUMBER_OF_NUCS * i] == 1
+    assert sum(base_array) == 100 + 70_000 * 10 + 50
+    assert sum(metrics.phred_count_table()) == 100 + 70_000 * 10 + 50
+
+
+def test_qc_metrics_tables_ranges():
+    metrics = QCMetrics()
+    metrics.add_read(FastqRecordView("name", "ACGTNACGTN", "ABCDEFGHIJ"))
+    metrics.add_read(FastqRecordView("name", "GGGGGG", "IIIIII"))
+    ranges = [(0, 3), (3, 4), [4, 10], (8, 100), (100, 200)]
+    base_table = metrics.base_count_table()
+    phred_table = metrics.phred_count_table()
+    for table, ranged, size in (
+            (base_table, metrics.base_count_table(ranges=ranges),
+             NUMBER_OF_NUCS),
+            (phred_table, metrics.phred_count_table(ranges), NUMBER_OF_PHREDS)):
+        assert len(ranged) == len(ranges) * size
+        for i, (start, stop) in enumerate(ranges):
+            for j in range(size):
+                assert ranged[i * size + j] == \
+                    sum(table[start * size + j: stop * size: size])
+    assert len(metrics.base_count_table(ranges=[])) == 0
+
+
+@pytest.mark.parametrize("ranges", [[(-1, 3)], [(3, 2)], [(1, 2, 3)],
+                                    [3], 3])
+def test_qc_metrics_tables_invalid_ranges(ranges):
+    metrics = QCMetrics()
+    with pytest.raises((ValueError, TypeError)):
+        metrics.base_count_table(ranges=ranges)
+
+
+def test_qc_metrics_sequence_lengths():
+    metrics = QCMetrics()
+    for sequence in ("ACGT", "ACGT", "A", "", "ACGTACGT"):
+        metrics.add_read(FastqRecordView("name", sequence, "I" * len(sequence)))
+    assert list(metrics.sequence_lengths()) == [1, 1, 0, 0, 2, 0, 0, 0, 1]
+    # The empty read has no GC content or average quality.
+    assert metrics.number_of_reads == 5
+    assert sum(metrics.gc_content()) == 4
+    assert sum(metrics.phred_scores()) == 4
+    assert list(QCMetrics().sequence_lengths()) == [0]
@@ -0,0 +1,310 @@
+# Copyright (C) 2023 Leiden University Medical Center
+# This file is part of Sequali
+#
+# Sequali is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as
+# published by the Free Software Foundation, either version 3 of the
+# License, or (at your option) any later version.
+#
+# Sequali is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with Sequali.  If not, see <https://www.gnu.org/licenses/
+
+import gzip
+import io
+import math
+import threading
+from pathlib import Path
+
+import pytest
+
+from sequali import (
+    AdapterCounter, FastqParser, FastqRecordArrayView,
+    OverrepresentedSequences, PerTileQuality, QCMetrics, QCPipeline
+)
+from sequali._qc import DedupEstimator, InsertSizeMetrics, NanoStats
+
+DATA = Path(__file__).parent / "data"
+ILLUMINA_FASTQ = DATA / "LTB-A-BC001_S1_L003_R1_001_shortened.fastq.gz"
+NANOPORE_FASTQ = DATA / "100_nanopore_reads.fastq.gz"
+ADAPTERS = ("AGATCGGAAGAG", "CTGTCTCTTATA")
+
+
+def illumina_modules():
+    return [
+        QCMetrics(),
+        AdapterCounter(ADAPTERS),
+        PerTileQuality(),
+        OverrepresentedSequences(sample_every=1),
+        DedupEstimator(),
+    ]
+
+
+def add_file(fastq, modules, threads, split_modules=False):
+    pipeline = QCPipeline(modules, threads=threads,
+                          split_modules=split_modules)
+    with gzip.open(fastq, "rb") as fileobj:
+        parser = FastqParser(fileobj, initial_buffersize=16 * 1024)
+        for record_array in parser:
+            pipeline.add_record_array(record_array)
+    pipeline.finish()
+
+
+def assert_tile_counts_equal(counts1, counts2):
+    assert len(counts1) == len(counts2)
+    for (tile1, errors1, number1), (tile2, errors2, number2) in zip(
+            counts1, counts2):
+        assert tile1 == tile2
+        assert number1 == number2
+        assert all(math.isclose(x, y) for x, y in zip(errors1, errors2))
+
+
+@pytest.mark.parametrize(["threads", "split_modules"],
+                         [(1, False), (2, False), (4, False),
+                          (1, True), (2, True), (4, True), (8, True)])
+def test_qc_pipeline_same_as_serial(threads, split_modules):
+    serial = illumina_modules()
+    with gzip.open(ILLUMINA_FASTQ, "rb") as fileobj:
+        for record_array in FastqParser(fileobj, initial_buffersize=16 * 1024):
+            for module in serial:
+                module.add_record_array(record_array)
+    parallel = illumina_modules()
+    add_file(ILLUMINA_FASTQ, parallel, threads, split_modules)
+    metrics1, adapters1, tiles1, overrep1, dedup1 = serial
+    metrics2, adapters2, tiles2, overrep2, dedup2 = parallel
+    assert metrics2.number_of_reads == metrics1.number_of_reads
+    assert metrics2.base_count_table() == metrics1.base_count_table()
+    assert metrics2.phred_count_table() == metrics1.phred_count_table()
+    assert metrics2.gc_content() == metrics1.gc_content()
+    assert metrics2.phred_scores() == metrics1.phred_scores()
+    assert adapters2.number_of_sequences == adapters1.number_of_sequences
+    assert adapters2.get_counts() == adapters1.get_counts()
+    assert_tile_counts_equal(tiles2.get_tile_counts(),
+                             tiles1.get_tile_counts())
+    assert overrep2.sequence_counts() == overrep1.sequence_counts()
+    assert overrep2.total_fragments == overrep1.total_fragments
+    assert dedup2.tracked_sequences == dedup1.tracked_sequences
+    assert dedup2.duplication_counts() == dedup1.duplication_counts()
+
+
+@pytest.mark.parametrize("threads", [1, 3])
+def test_qc_pipeline_nanostats(threads):
+    # QCMetrics sets the accumulated error rate that NanoStats uses.
+    metrics = QCMetrics()
+    nanostats = NanoStats()
+    add_file(NANOPORE_FASTQ, [metrics, nanostats], threads)
+    serial_metrics = QCMetrics()
+    serial_nanostats = NanoStats()
+    with gzip.open(NANOPORE_FASTQ, "rb") as fileobj:
+        for record_array in FastqParser(fileobj):
+            serial_metrics.add_record_array(record_array)
+            serial_nanostats.add_record_array(record_array)
+
+    def info_key(info):
+        return (info.start_time, info.channel_id, info.length,
+                info.cumulative_error_rate)
+
+    infos = sorted(map(info_key, nanostats.nano_info_iterator()))
+    serial_infos = sorted(map(info_key, serial_nanostats.nano_info_iterator()))
+    assert len(infos) == 100
+    assert infos == serial_infos
+    assert nanostats.minimum_time == serial_nanostats.minimum_time
+    assert nanostats.maximum_time == serial_nanostats.maximum_time
+
+
+def test_qc_pipeline_error_from_worker():
+    metrics = QCMetrics()
+    pipeline = QCPipeline([metrics], threads=2)
+    # The parser does not check the phred scores. The second record ends up
+    # in the worker thread.
+    parser = FastqParser(io.BytesIO(b"@a\nACGT\n+\nIIII\n"
+                                    b"@b\nACGT\n+\nII I\n"))
+    record_array = next(parser)
+    with pytest.raises(ValueError) as error:
+        pipeline.add_record_array(record_array)
+    error.match("Not a valid phred character")
+    # The modules can be used again after an error.
+    metrics.dump()
+
+
+def error_while_busy(modules, action):
+    """Call action while a pipeline processes modules in another thread and
+    return the RuntimeError it raised, if any."""
+    record = b"@read\n" + b"ACGT" * 50 + b"\n+\n" + b"I" * 200 + b"\n"
+    record_array = next(FastqParser(io.BytesIO(record * 10000),
+                                    initial_buffersize=4 * 1024 * 1024))
+    pipeline = QCPipeline(modules, threads=2)
+    done = threading.Event()
+
+    def add_record_arrays():
+        for _ in range(1000):
+            if done.is_set():
+                return
+            pipeline.add_record_array(record_array)
+
+    thread = threading.Thread(target=add_record_arrays)
+    thread.start()
+    error = None
+    try:
+        while thread.is_alive():
+            try:
+                action()
+            except RuntimeError as e:
+                error = e
+                break
+    finally:
+        done.set()
+        thread.join()
+    pipeline.finish()
+    return error
+
+
+def test_qc_pipeline_modules_busy():
+    metrics = QCMetrics()
+    error = error_while_busy([metrics], metrics.dump)
+    assert "in use by a QCPipeline" in str(error)
+    # Once the pipeline returns, the module can be used again.
+    metrics.dump()
+
+
+def test_qc_pipeline_merge_busy_module():
+    dedup = DedupEstimator()
+    error = error_while_busy([dedup], lambda: DedupEstimator().merge(dedup))
+    assert "in use by a QCPipeline" in str(error)
+    dedup.merge(DedupEstimator())
+
+
+def test_qc_pipeline_unsupported_module():
+    with pytest.raises(TypeError) as error:
+        QCPipeline([QCMetrics(), InsertSizeMetrics()])
+    error.match("InsertSizeMetrics")
+
+
+def test_qc_pipeline_invalid_threads():
+    with pytest.raises(ValueError) as error:
+        QCPipeline([QCMetrics()], threads=0)
+    error.match("threads")
+
+
+def test_qc_pipeline_finished():
+    pipeline = QCPipeline([QCMetrics()], threads=2)
+    pipeline.finish()
+    # Calling finish twice is allowed.
+    pipeline.finish()
+    with pytest.raises(RuntimeError) as error:
+        pipeline.add_record_array(FastqRecordArrayView([]))
+    error.match("finished")
+
+
+def test_qc_pipeline_attributes():
+    modules = [QCMetrics(), PerTileQuality()]
+    pipeline = QCPipeline(modules, threads=3)
+    assert pipeline.modules == tuple(modules)
+    assert pipeline.threads == 3
+    assert not pipeline.split_modules
+
+
+@pytest.mark.parametrize("threads", [2, 4])
+def test_qc_pipeline_split_modules_nanostats_order(threads):
+    # With split_modules the original modules see all reads in order, and
+    # NanoStats runs on the same thread after QCMetrics.
+    modules = [QCMetrics(), AdapterCounter(ADAPTERS), NanoStats()]
+    add_file(NANOPORE_FASTQ, modules, threads, split_modules=True)
+    serial_metrics = QCMetrics()
+    serial_nanostats = NanoStats()
+    with gzip.open(NANOPORE_FASTQ, "rb") as fileobj:
+        for record_array in FastqParser(fileobj):
+            serial_metrics.add_record_array(record_array)
+            serial_nanostats.add_record_array(record_array)
+    infos = [(info.start_time, info.length, info.cumulative_error_rate)
+             for info in modules[2].nano_info_iterator()]
+    serial_infos = [(info.start_time, info.length, info.cumulative_error_rate)
+                    for info in serial_nanostats.nano_info_iterator()]
+    assert infos == serial_infos
+
+
+def test_qc_pipeline_split_modules_error():
+    pipeline = QCPipeline([AdapterCounter(ADAPTERS), QCMetrics()], threads=2,
+                          split_modules=True)
+    assert pipeline.split_modules
+    parser = FastqParser(io.BytesIO(b"@a\nACGT\n+\nII I\n"))
+    with pytest.raises(ValueError) as error:
+        pipeline.add_record_array(next(parser))
+    error.match("Not a valid phred character")
+
+
+@pytest.mark.parametrize("threads", [1, 3])
+def test_qc_pipeline_sync(threads):
+    metrics = QCMetrics()
+    adapters = AdapterCounter(ADAPTERS)
+    pipeline = QCPipeline([metrics, adapters], threads=threads)
+    serial_metrics = QCMetrics()
+    with gzip.open(ILLUMINA_FASTQ, "rb") as fileobj:
+        parser = FastqParser(fileobj, initial_buffersize=16 * 1024)
+        for record_array in parser:
+            pipeline.add_record_array(record_array)
+            serial_metrics.add_record_array(record_array)
+            pipeline.sync([metrics])
+            # Only the selected modules are synchronized.
+            assert metrics.number_of_reads == serial_metrics.number_of_reads
+            assert metrics.base_count_table() == \
+                serial_metrics.base_count_table()
+    pipeline.sync()
+    assert adapters.number_of_sequences == serial_metrics.number_of_reads
+    pipeline.finish()
+    # Finishing after syncing does not count any reads twice.
+    assert metrics.number_of_reads == serial_metrics.number_of_reads
+    assert metrics.phred_count_table() == serial_metrics.phred_count_table()
+    assert adapters.number_of_sequences == serial_metrics.number_of_reads
+
+
+def test_qc_pipeline_sync_unknown_module():
+    pipeline = QCPipeline([QCMetrics()], threads=2)
+    with pytest.raises(ValueError) as error:
+        pipeline.sync([QCMetrics()])
+    error.match("not a module of this pipeline")
+    pipeline.finish()
+
+
+@pytest.mark.parametrize(["threads", "split_modules"],
+                         [(1, False), (3, False), (3, True)])
+def test_qc_pipeline_module_times(threads, split_modules):
+    modules = illumina_modules()
+    pipeline = QCPipeline(modules, threads=threads,
+                          split_modules=split_modules, profile=True)
+    assert pipeline.module_times() == [0.0] * len(modules)
+    with gzip.open(ILLUMINA_FASTQ, "rb") as fileobj:
+        parser = FastqParser(fileobj, initial_buffersize=16 * 1024)
+        for record_array in parser:
+            pipeline.add_record_array(record_array)
+    pipeline.finish()
+    times = pipeline.module_times()
+    assert len(times) == len(modules)
+    assert all(seconds > 0.0 for seconds in times)
+
+
+def test_qc_pipeline_module_times_not_profiled():
+    modules = illumina_modules()
+    add_file(ILLUMINA_FASTQ, modules, threads=2)
+    pipeline = QCPipeline(modules, threads=2)
+    pipeline.finish()
+    assert pipeline.module_times() == [0.0] * len(modules)
+
+
+def test_qc_pipeline_overrepresented_sequences_sketch():
+    serial = OverrepresentedSequences(sample_every=1,
+                                      sketch_memory=4 * 1024 * 1024)
+    parallel = OverrepresentedSequences(sample_every=1,
+                                        sketch_memory=4 * 1024 * 1024)
+    with gzip.open(ILLUMINA_FASTQ, "rb") as fileobj:
+        parser = FastqParser(fileobj, initial_buffersize=16 * 1024)
+        for record_array in parser:
+            serial.add_record_array(record_array)
+    add_file(ILLUMINA_FASTQ, [parallel], threads=3)
+    assert parallel.sketch_memory == serial.sketch_memory
+    assert parallel.sampled_sequences == serial.sampled_sequences
+    assert parallel.sequence_counts() == serial.sequence_counts()
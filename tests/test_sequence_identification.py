@@ -14,10 +14,27 @@
 # You should have received a copy of the GNU Affero General Public License
 # along with Sequali.  If not, see <https://www.gnu.org/licenses/
 
+import json
+import os
+import random
+import subprocess
+import sys
+import time
+import warnings
+
 import pytest
 
+from sequali import sequence_identification
+from sequali._seqident import SequenceIndex
 from sequali.sequence_identification import (
+    SEQUENCE_INDEX_CACHE_MAX_AGE,
     canonical_kmers,
+    create_default_sequence_index,
+    default_sequence_index_cache_file,
+    identify_sequence,
+    identify_sequence_builtin,
+    identify_sequence_with_index,
+    identify_sequences_builtin,
     reverse_complement,
     sequence_identity
 )
@@ -62,3 +79,232 @@ def test_canonical_kmers():
 ])
 def test_sequence_identity(target, query, result):
     assert sequence_identity(target, query) == result
+
+
+TEST_SEQUENCES = [
+    ("adapter", "AGATCGGAAGAGCACACGTCTGAACTCCAGTCA"),
+    ("polyA", "A" * 40),
+    ("long_adapter", "GGGGGAGATCGGAAGAGCACACGTCTGAACTCCAGTCAGGGGGG"),
+    ("random", "GATTACAGATTACACCGGTTAACCGGTTAACC"),
+]
+
+
+def test_sequence_index_properties():
+    index = SequenceIndex(TEST_SEQUENCES, k=13)
+    assert index.k == 13
+    assert index.number_of_sequences == 4
+    assert index.number_of_kmers == sum(
+        len(canonical_kmers(sequence, 13)) for _, sequence in TEST_SEQUENCES)
+
+
+@pytest.mark.parametrize("k", [0, 2, 12, 23])
+def test_sequence_index_wrong_k(k):
+    with pytest.raises(ValueError) as error:
+        SequenceIndex(TEST_SEQUENCES, k=k)
+    error.match(str(k))
+
+
+def test_sequence_index_non_ascii():
+    with pytest.raises(ValueError) as error:
+        SequenceIndex([("name", "ACGTÄ")])
+    error.match("ascii")
+
+
+@pytest.mark.parametrize(["query", "result"], [
+    # The shortest sequence with the most k-mers is preferred.
+    ("AGATCGGAAGAGCACACGTCTGAAC", (25, 25, "adapter")),
+    (reverse_complement("AGATCGGAAGAGCACACGTCTGAAC"), (25, 25, "adapter")),
+    ("AAAAAAAAAAAAAAAAAAAAA", (21, 21, "polyA")),
+    ("TTTTTTTTTTTTTTTTTTTTT", (21, 21, "polyA")),
+    ("GATTACAGATTACACCGGTTAACCG", (25, 25, "random")),
+    ("CCCCCCCCCCCCCCCCCCCCC", (0, 21, "No match")),
+])
+def test_sequence_index_identify(query, result):
+    index = SequenceIndex(TEST_SEQUENCES, k=13)
+    assert index.identify(query) == result
+    assert identify_sequence_with_index(query, index) == result
+
+
+@pytest.mark.parametrize("query", [
+    "AGATCGGAAGAGCACACGTCTGAAC",
+    reverse_complement("AGATCGGAAGAGCACACGTCTGAAC"),
+    "GATTACAGATTACACCGGTTAACCG",
+    "CCCCCCCCCCCCCCCCCCCCC",
+])
+def test_identify_sequence_deprecated(query):
+    # The old signature takes a k-mer dictionary and a sequence lookup.
+    kmer_index = {}
+    for name, sequence in TEST_SEQUENCES:
+        for kmer in canonical_kmers(sequence, 13):
+            kmer_index.setdefault(kmer, []).append(name)
+    lookup = dict(TEST_SEQUENCES)
+    index = SequenceIndex(TEST_SEQUENCES, k=13)
+    with warnings.catch_warnings(record=True) as caught:
+        warnings.simplefilter("always")
+        from_dict = identify_sequence(query, kmer_index, lookup, 13, True)
+        from_index = identify_sequence(query, index, lookup, 13, True)
+    assert all(issubclass(warning.category, DeprecationWarning)
+               for warning in caught)
+    assert len(caught) == 2
+    assert from_dict == from_index == index.identify(query)
+
+
+def test_sequence_index_identify_no_reverse_complement():
+    index = SequenceIndex(TEST_SEQUENCES, k=13)
+    query = reverse_complement("AGATCGGAAGAGCACACGTCTGAAC")
+    matches, max_matches, best_match = index.identify(
+        query, match_reverse_complement=False)
+    assert max_matches == 25
+    assert matches < 25
+
+
+def test_sequence_index_identify_too_long():
+    index = SequenceIndex(TEST_SEQUENCES, k=13)
+    with pytest.raises(ValueError) as error:
+        index.identify("GGGGGAGATCGGAAGAGCACACGTCTGAACTCCAGTCAGG")
+    error.match("32")
+    # Sequences without candidates are not aligned.
+    assert index.identify("C" * 40) == (0, 40, "No match")
+
+
+@pytest.mark.parametrize("threads", [1, 2, 3, 8])
+def test_sequence_index_identify_batch(threads):
+    index = SequenceIndex(TEST_SEQUENCES, k=13)
+    queries = [sequence[i:i+25] for _, sequence in TEST_SEQUENCES
+               for i in range(0, 15, 3)] + ["C" * 21, "ACGT"]
+    assert index.identify_batch(queries, threads=threads) == [
+        index.identify(query) for query in queries]
+    assert index.identify_batch([], threads=threads) == []
+
+
+def test_identify_sequences_builtin():
+    sequences = [
+        "AGATCGGAAGAGCACACGTCTGAACTCCAGTCA"[:31],
+        "CTGTCTCTTATACACATCTGACGCTGCCGAC",
+        "ACGT",
+    ]
+    assert identify_sequences_builtin(sequences, threads=2) == [
+        identify_sequence_builtin(sequence) for sequence in sequences]
+
+
+def test_sequence_index_save_load(tmp_path):
+    index = SequenceIndex(TEST_SEQUENCES, k=11)
+    index_file = tmp_path / "index.idx"
+    index.save(str(index_file))
+    loaded = SequenceIndex.load(str(index_file))
+    assert loaded.k == 11
+    assert loaded.number_of_sequences == index.number_of_sequences
+    assert loaded.number_of_kmers == index.number_of_kmers
+    queries = [sequence[i:i+25] for _, sequence in TEST_SEQUENCES
+               for i in range(0, 15, 3)] + ["C" * 21]
+    assert loaded.identify_batch(queries) == index.identify_batch(queries)
+
+
+def test_sequence_index_save_load_empty(tmp_path):
+    index_file = tmp_path / "index.idx"
+    SequenceIndex([]).save(str(index_file))
+    loaded = SequenceIndex.load(str(index_file))
+    assert loaded.number_of_sequences == 0
+    assert loaded.identify("ACGTACGTACGTACGT") == (0, 16, "No match")
+
+
+@pytest.mark.parametrize(["change", "message"], [
+    (lambda data: b"NOTANIDX" + data[8:], "not a sequence index file"),
+    (lambda data: data[:8] + b"\xff" + data[9:], "unsupported version"),
+    (lambda data: data[:-1], "file size"),
+    (lambda data: data + b"\0" * 8, "file size"),
+    (lambda data: data[:10], "too small"),
+])
+def test_sequence_index_load_invalid(tmp_path, change, message):
+    index_file = tmp_path / "index.idx"
+    SequenceIndex(TEST_SEQUENCES).save(str(index_file))
+    index_file.write_bytes(change(index_file.read_bytes()))
+    with pytest.raises(ValueError) as error:
+        SequenceIndex.load(str(index_file))
+    error.match(message)
+
+
+def test_sequence_index_load_corrupt_sequence_id(tmp_path):
+    index_file = tmp_path / "index.idx"
+    index = SequenceIndex(TEST_SEQUENCES)
+    index.save(str(index_file))
+    data = bytearray(index_file.read_bytes())
+    # The sequence ids follow the header and the k-mers.
+    ids_offset = 56 + 8 * index.number_of_kmers
+    data[ids_offset:ids_offset + 4] = b"\xff\xff\xff\x00"
+    index_file.write_bytes(data)
+    with pytest.raises(ValueError) as error:
+        SequenceIndex.load(str(index_file))
+    error.match("out of range")
+
+
+def test_default_sequence_index_cache(tmp_path, monkeypatch):
+    monkeypatch.setenv("SEQUALI_CACHE_DIR", str(tmp_path))
+    cache_file = default_sequence_index_cache_file(13)
+    assert cache_file.startswith(str(tmp_path))
+    # Unused indexes of other contaminant files are removed. Indexes that
+    # were used recently, and indexes for other k, are kept.
+    outdated = tmp_path / "contaminants_k13_0123456789abcdef.idx"
+    recent = tmp_path / "contaminants_k13_fedcba9876543210.idx"
+    other_k = tmp_path / "contaminants_k11_0123456789abcdef.idx"
+    for path in (outdated, recent, other_k):
+        path.write_bytes(b"")
+    unused_time = time.time() - SEQUENCE_INDEX_CACHE_MAX_AGE - 60
+    os.utime(outdated, (unused_time, unused_time))
+    os.utime(other_k, (unused_time, unused_time))
+    create_default_sequence_index.cache_clear()
+    try:
+        index = create_default_sequence_index(13)
+        assert os.path.exists(cache_file)
+        loaded = SequenceIndex.load(cache_file)
+    finally:
+        create_default_sequence_index.cache_clear()
+    assert loaded.number_of_kmers == index.number_of_kmers
+    assert sorted(os.listdir(tmp_path)) == sorted(
+        [os.path.basename(cache_file), recent.name, other_k.name])
+    # Loading the index marks it as used.
+    os.utime(cache_file, (unused_time, unused_time))
+    try:
+        create_default_sequence_index(13)
+    finally:
+        create_default_sequence_index.cache_clear()
+    assert os.stat(cache_file).st_mtime > unused_time + 60
+
+
+def test_default_sequence_index_cache_file_content_based(tmp_path,
+                                                           monkeypatch):
+    contaminants = tmp_path / "contaminants.fasta"
+    contaminants.write_text(">adapter\nGATTACA\n")
+    monkeypatch.setattr(sequence_identification, "DEFAULT_CONTAMINANTS_FILES",
+                        [str(contaminants)])
+    cache_file = default_sequence_index_cache_file(13)
+    # A reinstall of the same files does not change the name.
+    os.utime(contaminants, ns=(0, 0))
+    assert default_sequence_index_cache_file(13) == cache_file
+    contaminants.write_text(">adapter\nGATTACAGATTACA\n")
+    assert default_sequence_index_cache_file(13) != cache_file
+
+
+def test_sequence_identity_simd_default_same_as_dispatched():
+    # The dispatch is chosen when the module is loaded, so the default code
+    # path is run in a new process.
+    rng = random.Random(9)
+    pairs = []
+    for _ in range(50):
+        target = "".join(rng.choices("ACGT", k=rng.randint(20, 200)))
+        start = rng.randint(0, len(target) - 20)
+        query = list(target[start:start + rng.randint(10, 31)])
+        for _ in range(rng.randint(0, 4)):
+            query[rng.randrange(len(query))] = rng.choice("ACGT")
+        pairs.append((target, "".join(query)))
+    script = ("import json, sys\n"
+              "from sequali._seqident import sequence_identity\n"
+              "pairs = json.load(sys.stdin)\n"
+              "print(json.dumps([sequence_identity(t, q) for t, q in pairs]))")
+    process = subprocess.run(
+        [sys.executable, "-c", script], input=json.dumps(pairs).encode(),
+        env=dict(os.environ, SEQUALI_SIMD="default"), stdout=subprocess.PIPE,
+        check=True)
+    default = json.loads(process.stdout)
+    assert default == [sequence_identity(target, query)
+                       for target, query in pairs]
@@ -14,14 +14,18 @@
 # You should have received a copy of the GNU Affero General Public License
 # along with Sequali.  If not, see <https://www.gnu.org/licenses/
 
+import gzip
+import io
+import sys
 from pathlib import Path
 
 import pytest
 
-from sequali.util import (fasta_parser,
+from sequali._qc import FileMapping
+from sequali.util import (BGZFReader, NGSFile, fasta_parser,
                           fastq_header_is_illumina, fastq_header_is_nanopore,
                           guess_sequencing_technology_from_bam_header,
-                          sequence_names_match)
+                          is_bgzf, sequence_names_match, split_byte_ranges)
 
 from .test_fastq_record_array import NAME_MATCH_TESTS
 
@@ -29,6 +33,9 @@ from .test_fastq_record_array import NAME_MATCH_TESTS
 DATA = Path(__file__).parent / "data"
 SAM = DATA / ("project.NIST_NIST7035_H7AP8ADXX_TAAGGCGA_1_NA12878.bwa."
               "markDuplicates.sam")
+BAM = DATA / ("project.NIST_NIST7035_H7AP8ADXX_TAAGGCGA_1_NA12878.bwa."
+              "markDuplicates.bam")
+NANOPORE_BAM = DATA / "dorado_nanopore_100reads.bam"
 
 
 @pytest.mark.parametrize(["header", "is_illumina"], (
@@ -70,3 +77,76 @@ def test_fasta_parser():
 @pytest.mark.parametrize(["name1", "name2", "expected"], NAME_MATCH_TESTS)
 def test_sequence_names_match(name1, name2, expected):
     assert sequence_names_match(name1, name2) is expected
+
+
+def test_is_bgzf():
+    assert is_bgzf(BAM.read_bytes())
+    assert not is_bgzf(gzip.compress(b"@read\nA\n+\nI\n"))
+    assert not is_bgzf(b"")
+
+
+@pytest.mark.parametrize("threads", [1, 2, 4])
+def test_bgzf_reader(threads):
+    compressed = NANOPORE_BAM.read_bytes()
+    with BGZFReader(io.BytesIO(compressed), threads=threads,
+                    blocks_per_batch=1) as reader:
+        result = reader.read()
+    assert result == gzip.decompress(compressed)
+
+
+def test_bgzf_reader_crc_mismatch():
+    compressed = bytearray(BAM.read_bytes())
+    # Flip a bit in the CRC32 of the first block.
+    block_size = int.from_bytes(compressed[16:18], "little") + 1
+    compressed[block_size - 8] ^= 1
+    with BGZFReader(io.BytesIO(bytes(compressed))) as reader:
+        with pytest.raises(ValueError) as error:
+            reader.read()
+    error.match("CRC32")
+
+
+def test_bgzf_reader_truncated():
+    compressed = BAM.read_bytes()
+    with BGZFReader(io.BytesIO(compressed[:-30])) as reader:
+        with pytest.raises(EOFError):
+            reader.read()
+
+
+def test_bgzf_reader_not_bgzf():
+    with BGZFReader(io.BytesIO(gzip.compress(b"A" * 100))) as reader:
+        with pytest.raises(ValueError) as error:
+            reader.read()
+    error.match("BGZF")
+
+
+def test_ngs_file_bgzf_threads():
+    with NGSFile(str(NANOPORE_BAM), threads=0) as serial:
+        expected = [(view.name(), view.sequence(), view.qualities())
+                    for record_array in serial for view in record_array]
+    with NGSFile(str(NANOPORE_BAM), threads=3) as threaded:
+        assert isinstance(threaded.file.raw, BGZFReader)
+        result = [(view.name(), view.sequence(), view.qualities())
+                  for record_array in threaded for view in record_array]
+    assert result == expected
+
+
+@pytest.mark.skipif(sys.platform == "win32",
+                    reason="Memory mapping is not supported on Windows")
+def test_ngs_file_uncompressed_fastq_mmap():
+    fastq = DATA / "100_illumina_adapters.fastq"
+    with NGSFile(str(fastq)) as ngs_file:
+        record_arrays = list(ngs_file)
+        assert ngs_file.format == "FASTQ"
+        assert ngs_file.sequencing_technology == "illumina"
+        assert ngs_file.progress.current_processed_bytes == \
+            fastq.stat().st_size
+    assert isinstance(record_arrays[0].obj, FileMapping)
+    assert sum(len(record_array) for record_array in record_arrays) == 100
+
+
+def test_split_byte_ranges():
+    assert split_byte_ranges(10, 1) == [(0, 10)]
+    assert split_byte_ranges(10, 3) == [(0, 3), (3, 6), (6, 10)]
+    assert split_byte_ranges(0, 2) == [(0, 0), (0, 0)]
+    with pytest.raises(ValueError):
+        split_byte_ranges(10, 0)